@@ -0,0 +1,116 @@
+#ifndef CHIBI19_A_A_STAR_NODE_H
+#define CHIBI19_A_A_STAR_NODE_H
+
+#include "ros/ros.h"
+#include "nav_msgs/Path.h"
+#include "nav_msgs/OccupancyGrid.h"
+#include "geometry_msgs/PoseStamped.h"
+#include "geometry_msgs/PointStamped.h"
+#include "chibi19_a/d_star_lite.h"
+#include "chibi19_a/ara_star.h"
+#include "chibi19_a/navigation_function.h"
+#include "chibi19_a/multi_resolution.h"
+#include "chibi19_a/grid_search.h"
+#include "chibi19_a/path_cache.h"
+#include "chibi19_a/latency_monitor.h"
+
+struct waypoint{
+	double x;
+	double y;
+};
+
+//a_starノード(実行ファイルとnodeletで共通)
+//状態はすべてメンバに持ち、10Hzのタイマで経路探索を進める
+class A_star
+{
+private:
+	bool map_received;
+	bool initflag;
+	bool setWP;
+	int count;
+	//読み込んだwaypointの数(set_waypointでwaypointsは現在位置と戻りの分だけ増える)
+	int waycount;
+	std::vector<waypoint> waypoints;
+	nav_msgs::Path roomba_gpath;
+	//publishした後は書き換えない(経路が変わるたびに作り直す)
+	nav_msgs::Path::Ptr samp_path;
+	geometry_msgs::PoseStamped::ConstPtr roomba_status;
+	geometry_msgs::PoseStamped::ConstPtr current_pose;
+	nav_msgs::OccupancyGrid map;
+	std::vector<std::vector<char> > grid;
+	std::vector<int> init;
+	std::vector<int> goal;
+	std::vector<std::vector<geometry_msgs::PoseStamped> > segments;
+	std::vector<D_star_lite> d_star;
+	std::vector<ARA_star> ara_star;
+	std::vector<bool> blocked;
+	std::string planner;
+	std::string path_sampling;
+	double block_radius;
+	double pose_interval;
+	int los_max_cost;
+	double time_budget;
+	double initial_epsilon;
+	double epsilon_step;
+	bool optimize_route;
+	std::string heuristic_type;
+	double nav_margin;
+	double nav_goal_tolerance;
+	Navigation_function nav_function;
+	int nav_target;
+	bool nav_dirty;
+	Multi_resolution_planner multi_resolution;
+	int resolution_levels;
+	double corridor_width;
+	std::unique_ptr<Grid_search_base> grid_search;
+	int neighborhood;
+	std::string cost_model;
+	bool path_published;
+	bool use_path_cache;
+	double path_cache_quantum;
+	Path_cache path_cache;
+	uint64_t map_hash;
+
+	unsigned int map_row;
+	unsigned int map_col;
+
+	ros::NodeHandle nh;
+	ros::Publisher roomba_gpath_pub;
+	ros::Publisher nav_function_pub;
+	ros::Subscriber map_sub;
+	ros::Subscriber cost_sub;
+	ros::Subscriber roomba_status_sub;
+	ros::Subscriber blocked_sub;
+	ros::Timer timer;
+	Latency_monitor monitor;
+
+	bool search_path_d_star(void);
+	bool search_path_theta_star(Cell, Cell, std::vector<Cell>&);
+	bool search_path_ara_star(void);
+	bool search_path_multi_resolution(Cell, Cell, std::vector<Cell>&);
+	void add_segment(const std::vector<Cell>&);
+	std::string cache_params(void);
+	void shortcut_sampling_path(void);
+	void cells_to_poses(const std::vector<Cell>&, std::vector<geometry_msgs::PoseStamped>&);
+	void repair_path(const std::vector<Cell>&);
+	void rebuild_path(void);
+	bool optimize_waypoint(std::vector<waypoint>&);
+	void pub_nav_function(void);
+	void update(const ros::TimerEvent&);
+
+public:
+	A_star(ros::NodeHandle, ros::NodeHandle);
+	void map_callback(const nav_msgs::OccupancyGrid::ConstPtr& msg);
+	void cost_callback(const nav_msgs::OccupancyGrid::ConstPtr& msg);
+	void amcl_callback(const geometry_msgs::PoseStamped::ConstPtr& msg);
+	void blocked_callback(const geometry_msgs::PointStamped::ConstPtr& msg);
+	void set_waypoint(int, std::vector<waypoint>&);
+	bool search_path(float, float, float, float);
+	void pub_path(void);
+	void sampling_path(void);
+	void refine_path(void);
+	void update_nav_function(const std::vector<waypoint>&);
+	int get_waypoint_count(void) const;
+};
+
+#endif
@@ -0,0 +1,62 @@
+#ifndef CHIBI19_A_ARA_STAR_H
+#define CHIBI19_A_ARA_STAR_H
+
+#include <vector>
+#include <queue>
+#include <chrono>
+#include <unordered_map>
+#include "chibi19_a/grid_cell.h"
+
+//ARA* (Anytime Repairing A*)
+//膨張率epsilonのヒューリスティックで素早く解を出し、epsilonを下げながら
+//前回の探索結果(g値とINCONSリスト)を再利用して解を改善する
+class ARA_star
+{
+private:
+	struct Node{
+		double g;
+		int parent;
+		bool in_open;
+		bool closed;
+		bool incons;
+	};
+
+	struct Entry{
+		double f;
+		double g;
+		int id;
+	};
+
+	struct EntryCompare{
+		bool operator()(const Entry& a, const Entry& b) const;
+	};
+
+	const std::vector<std::vector<char> >* grid;
+	std::unordered_map<int, Node> nodes;
+	std::priority_queue<Entry, std::vector<Entry>, EntryCompare> open;
+
+	int row;
+	int col;
+	Cell start;
+	Cell goal;
+	double epsilon;
+	bool completed;
+	int expansions;
+
+	double cell_cost(int, int) const;
+	double fvalue(int, double) const;
+	void push(int);
+
+public:
+	ARA_star(void);
+	void init(const std::vector<std::vector<char> >&, Cell, Cell, double);
+	bool improve_path(std::chrono::steady_clock::time_point);
+	bool decrease_epsilon(double);
+	bool get_path(std::vector<Cell>&) const;
+	bool has_path(void) const;
+	bool is_completed(void) const;
+	double get_epsilon(void) const;
+	int get_expansions(void) const;
+};
+
+#endif
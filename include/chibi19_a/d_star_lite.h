@@ -0,0 +1,64 @@
+#ifndef CHIBI19_A_D_STAR_LITE_H
+#define CHIBI19_A_D_STAR_LITE_H
+
+#include <vector>
+#include <queue>
+#include <unordered_map>
+#include "chibi19_a/grid_cell.h"
+
+//D* Lite (Koenig & Likhachev)
+//goalから逆向きに探索し、探索木を保持したままコスト変化のあった部分だけを修復する
+class D_star_lite
+{
+private:
+	struct Key{
+		double k1;
+		double k2;
+	};
+
+	struct Node{
+		double g;
+		double rhs;
+		Key key;
+		bool in_open;
+	};
+
+	struct Entry{
+		Key key;
+		int id;
+	};
+
+	struct EntryCompare{
+		bool operator()(const Entry& a, const Entry& b) const;
+	};
+
+	const std::vector<std::vector<char> >* grid;
+	std::unordered_map<int, Node> nodes;
+	std::priority_queue<Entry, std::vector<Entry>, EntryCompare> open;
+
+	int row;
+	int col;
+	Cell start;
+	Cell goal;
+	int expansions;
+
+	int to_id(int, int) const;
+	bool is_valid(int, int) const;
+	double cell_cost(int, int) const;
+	double heuristic(int, int) const;
+	double get_g(int) const;
+	double get_rhs(int) const;
+	Key calc_key(int) const;
+	void update_vertex(int, int);
+	void push(int);
+
+public:
+	D_star_lite(void);
+	void init(const std::vector<std::vector<char> >&, Cell, Cell);
+	bool compute_path(void);
+	void update_cell(int, int);
+	bool get_path(std::vector<Cell>&) const;
+	int get_expansions(void) const;
+};
+
+#endif
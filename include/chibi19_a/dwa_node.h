@@ -0,0 +1,89 @@
+#ifndef CHIBI19_A_DWA_NODE_H
+#define CHIBI19_A_DWA_NODE_H
+
+#include "ros/ros.h"
+#include "std_msgs/Bool.h"
+#include "nav_msgs/Path.h"
+#include "nav_msgs/Odometry.h"
+#include "sensor_msgs/LaserScan.h"
+#include "geometry_msgs/PoseStamped.h"
+#include "chibi19_a/NavigationFunction.h"
+#include "chibi19_a/local_planner.h"
+#include "chibi19_a/latency_monitor.h"
+#include <fstream>
+
+//dwaノード(実行ファイルとnodeletで共通)
+//scanが来るたびにそのコールバックの中で制御する
+class Dwa
+{
+private:
+    //制御の状態
+    enum Control_state{
+        WAITING,     //入力がそろうのを待つ
+        TRACKING,    //gpathを追従する
+        LINE_STOP,   //白線を検知してstop_timeの間止まる
+        GOAL_REACHED //goalに着いた(gpathのgoalが変わるまで止まる)
+    };
+
+    Local_planner planner;
+    //replay_fileを指定すると、dwa_benchmarkで再生できるように入力を記録する
+    std::ofstream replay;
+
+    //受け取ったメッセージは複製せずにそのまま持つ
+    nav_msgs::Path::ConstPtr roomba_gpath;
+    nav_msgs::Odometry::ConstPtr roomba_odom;
+    geometry_msgs::PoseStamped::ConstPtr roomba_status;
+    Scan roomba_scan;
+    //遅延の計測用(いま制御に使っているscan)
+    ros::Time scan_stamp;
+    //publishした後は書き換えない(選び直すたびに作り直す)
+    nav_msgs::Path::Ptr lpath;
+    geometry_msgs::PoseStamped::Ptr gpath_goal;
+
+    bool line_detection;
+    double stop_time;
+    double max_speed;
+    double ignore_line;
+    double max_yawrate;
+    double roomba_radius;
+    double scan_timeout;
+
+    Control_state state;
+    Position reached_goal;
+    Position detected_line;
+    bool invalid_l_d;
+    bool timed_out;
+    ros::Time last_scan;
+    ros::Time line_stop_end;
+
+    ros::NodeHandle nh;
+    ros::Publisher roomba_cntl_pub;
+    ros::Publisher lpath_pub;
+    ros::Publisher gpath_goal_pub;
+    ros::Subscriber roomba_odom_sub;
+    ros::Subscriber roomba_scan_sub;
+    ros::Subscriber roomba_gpath_sub;
+    ros::Subscriber roomba_status_sub;
+    ros::Subscriber line_detection_sub;
+    ros::Subscriber nav_function_sub;
+    ros::Timer watchdog;
+    Latency_monitor monitor;
+
+    void log_best_traj(const std::vector<Status>&);
+    void log_gpath_goal(const Position&);
+    int is_goal(const Status&, const Position&) const;
+    void publish_cntl(int, double, double);
+    void control(void);
+    void watchdog_callback(const ros::TimerEvent&);
+
+public:
+    Dwa(ros::NodeHandle, ros::NodeHandle);
+    void odom_callback(const nav_msgs::Odometry::ConstPtr& msg);
+    void scan_callback(const sensor_msgs::LaserScan::ConstPtr& msg);
+    void gpath_callback(const nav_msgs::Path::ConstPtr& msg);
+    void amcl_callback(const geometry_msgs::PoseStamped::ConstPtr& msg);
+    void nav_function_callback(const chibi19_a::NavigationFunction::ConstPtr& msg);
+    void line_detection_callback(const std_msgs::Bool::ConstPtr& msg);
+};
+
+#endif
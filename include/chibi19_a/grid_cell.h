@@ -0,0 +1,38 @@
+#ifndef CHIBI19_A_GRID_CELL_H
+#define CHIBI19_A_GRID_CELL_H
+
+#include <algorithm>
+
+//経路探索で共通に使うグリッドのセルと近傍、cost_mapのコスト
+
+struct Cell{
+	int x;
+	int y;
+};
+
+//近傍の移動量。先頭の4つが4近傍、8つ全部で8近傍(5番目からが斜め)
+const int GRID_DELTA[8][2] = {
+	{-1,  0},
+	{ 0, -1},
+	{ 1,  0},
+	{ 0,  1},
+	{-1, -1},
+	{ 1, -1},
+	{ 1,  1},
+	{-1,  1}
+};
+
+//cost_mapの100は障害物
+inline bool is_passable(char c)
+{
+	return c != 100;
+}
+
+//セルに入るコスト(1 + cost_mapの値)
+//cost_mapの-1はインフレーション範囲外(障害物から十分離れたセル)なので0として扱う
+inline int enter_cost(char c)
+{
+	return 1 + std::max((int)c, 0);
+}
+
+#endif
@@ -0,0 +1,280 @@
+#ifndef CHIBI19_A_GRID_SEARCH_H
+#define CHIBI19_A_GRID_SEARCH_H
+
+#include <cmath>
+#include <limits>
+#include <queue>
+#include <memory>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include "chibi19_a/grid_cell.h"
+#include "chibi19_a/navigation_function.h"
+
+//近傍(4/8)、ヒューリスティック、コストモデルをテンプレート引数で与えるA*
+//内側のループは仮想関数や実行時の移動表を介さずにインライン展開される
+
+struct Four_connected{
+	static const int SIZE = 4;
+	static int dx(int i)
+	{
+		return GRID_DELTA[i][0];
+	}
+	static int dy(int i)
+	{
+		return GRID_DELTA[i][1];
+	}
+	static float length(int)
+	{
+		return 1.0f;
+	}
+	static bool diagonal(int)
+	{
+		return false;
+	}
+};
+
+struct Eight_connected{
+	static const int SIZE = 8;
+	static int dx(int i)
+	{
+		return GRID_DELTA[i][0];
+	}
+	static int dy(int i)
+	{
+		return GRID_DELTA[i][1];
+	}
+	static float length(int i)
+	{
+		return i < 4 ? 1.0f : 1.41421356f;
+	}
+	static bool diagonal(int i)
+	{
+		return i >= 4;
+	}
+};
+
+struct Manhattan_heuristic{
+	Cell goal;
+	void set_goal(Cell g)
+	{
+		goal = g;
+	}
+	float operator()(int x, int y) const
+	{
+		return std::abs(goal.x - x) + std::abs(goal.y - y);
+	}
+};
+
+struct Octile_heuristic{
+	Cell goal;
+	void set_goal(Cell g)
+	{
+		goal = g;
+	}
+	float operator()(int x, int y) const
+	{
+		int dx = std::abs(goal.x - x);
+		int dy = std::abs(goal.y - y);
+		return std::max(dx, dy) + 0.41421356f*std::min(dx, dy);
+	}
+};
+
+struct Euclidean_heuristic{
+	Cell goal;
+	void set_goal(Cell g)
+	{
+		goal = g;
+	}
+	float operator()(int x, int y) const
+	{
+		return std::sqrt((float)((goal.x - x)*(goal.x - x) + (goal.y - y)*(goal.y - y)));
+	}
+};
+
+//goalからのDijkstra(Navigation_function)の値。4近傍・cost_mapのコストモデルで厳密
+struct Precomputed_heuristic{
+	const Navigation_function* nav;
+	void set_goal(Cell)
+	{
+	}
+	float operator()(int x, int y) const
+	{
+		return nav->value(x, y);
+	}
+};
+
+struct Cost_map_cost{
+	static bool passable(char c)
+	{
+		return is_passable(c);
+	}
+	static float cost(char c)
+	{
+		return enter_cost(c);
+	}
+};
+
+struct Uniform_cost{
+	static bool passable(char c)
+	{
+		return is_passable(c);
+	}
+	static float cost(char)
+	{
+		return 1.0f;
+	}
+};
+
+//探索するセルを絞らない
+struct No_mask{
+	bool operator()(int, int) const
+	{
+		return true;
+	}
+};
+
+class Grid_search_base
+{
+protected:
+	int expansions;
+
+public:
+	Grid_search_base(void) : expansions(0) {}
+	virtual ~Grid_search_base(void) {}
+	virtual bool search(const std::vector<std::vector<char> >&, Cell, Cell, std::vector<Cell>&) = 0;
+	int get_expansions(void) const
+	{
+		return expansions;
+	}
+};
+
+//Maskはセル(x, y)を探索してよいかを返す(multi_resolutionの帯など)
+template <class Neighborhood, class Heuristic, class CostModel, class Mask = No_mask>
+class Grid_search : public Grid_search_base
+{
+private:
+	typedef std::pair<float, int> QueueEntry;
+
+	Heuristic heuristic;
+	Mask mask;
+	//goalが通れないセルでも到達を認める(粗い格子ではgoalのセルが障害物とまとめられることがある)
+	bool goal_passable;
+	//地図と同じ大きさの作業領域。触ったセルだけを次の探索の前に戻す
+	std::vector<float> g;
+	std::vector<signed char> parent;
+	std::vector<char> closed;
+	std::vector<int> touched;
+
+public:
+	explicit Grid_search(const Heuristic& h, const Mask& m = Mask()) : heuristic(h), mask(m), goal_passable(false) {}
+
+	void set_mask(const Mask& m)
+	{
+		mask = m;
+	}
+
+	void set_goal_passable(bool passable)
+	{
+		goal_passable = passable;
+	}
+
+	bool search(const std::vector<std::vector<char> >& grid, Cell start, Cell goal, std::vector<Cell>& path)
+	{
+		const float inf = std::numeric_limits<float>::infinity();
+		int row = grid.size();
+		int col = row ? grid[0].size() : 0;
+		std::priority_queue<QueueEntry, std::vector<QueueEntry>, std::greater<QueueEntry> > open;
+
+		path.clear();
+		expansions = 0;
+		if(g.size() != row*col){
+			g.assign(row*col, inf);
+			parent.assign(row*col, -1);
+			closed.assign(row*col, 0);
+			touched.clear();
+		}
+		for(int i = 0; i < touched.size(); i++){
+			g[touched[i]] = inf;
+			parent[touched[i]] = -1;
+			closed[touched[i]] = 0;
+		}
+		touched.clear();
+
+		if(start.x < 0 || start.x >= row || start.y < 0 || start.y >= col
+				|| goal.x < 0 || goal.x >= row || goal.y < 0 || goal.y >= col)
+			return false;
+
+		heuristic.set_goal(goal);
+		int s_id = start.x*col + start.y;
+		int g_id = goal.x*col + goal.y;
+		g[s_id] = 0.0f;
+		touched.push_back(s_id);
+		open.push(QueueEntry(heuristic(start.x, start.y), s_id));
+
+		bool found = false;
+		while(!open.empty()){
+			int id = open.top().second;
+			open.pop();
+			if(closed[id])
+				continue;
+			closed[id] = 1;
+			expansions++;
+			if(id == g_id){
+				found = true;
+				break;
+			}
+
+			int x = id / col;
+			int y = id % col;
+			float g_u = g[id];
+			for(int i = 0; i < Neighborhood::SIZE; i++){
+				int x2 = x + Neighborhood::dx(i);
+				int y2 = y + Neighborhood::dy(i);
+				if(x2 < 0 || x2 >= row || y2 < 0 || y2 >= col)
+					continue;
+				char c = grid[x2][y2];
+				int id2 = x2*col + y2;
+				if(!CostModel::passable(c) && !(goal_passable && id2 == g_id))
+					continue;
+				if(!mask(x2, y2))
+					continue;
+				//斜め移動で障害物の角をすり抜けない
+				if(Neighborhood::diagonal(i) && (!CostModel::passable(grid[x2][y]) || !CostModel::passable(grid[x][y2])))
+					continue;
+
+				float g2 = g_u + CostModel::cost(c)*Neighborhood::length(i);
+				if(g2 < g[id2]){
+					if(g[id2] == inf)
+						touched.push_back(id2);
+					g[id2] = g2;
+					parent[id2] = i;
+					open.push(QueueEntry(g2 + heuristic(x2, y2), id2));
+				}
+			}
+		}
+		if(!found)
+			return false;
+
+		Cell c = goal;
+		path.push_back(c);
+		while(c.x != start.x || c.y != start.y){
+			int i = parent[c.x*col + c.y];
+			c.x -= Neighborhood::dx(i);
+			c.y -= Neighborhood::dy(i);
+			path.push_back(c);
+		}
+		std::reverse(path.begin(), path.end());
+
+		return true;
+	}
+};
+
+//globalpath.yamlの文字列から実体化済みの探索器を選ぶ。不正な指定ならNULL
+//neighborhood: 4, 8 / heuristic: manhattan, octile, euclidean, nav_function / cost_model: cost_map, uniform
+//8近傍ではmanhattanとnav_function(4近傍の距離)は斜め移動を過大評価して最適でなくなるのでNULL
+Grid_search_base* create_grid_search(int, const std::string&, const std::string&, const Navigation_function*);
+//近傍に対してヒューリスティックが距離を過大評価しないか
+bool is_admissible(int, const std::string&);
+
+#endif
@@ -0,0 +1,54 @@
+#ifndef CHIBI19_A_LATENCY_MONITOR_H
+#define CHIBI19_A_LATENCY_MONITOR_H
+
+#include "ros/ros.h"
+#include <string>
+#include <vector>
+#include <map>
+#include <mutex>
+#include <fstream>
+
+//scanから各段階までの遅延を集計する(a_star, localization, dwaで共通)
+//record(stage, source, begin, end)は元のscanの時刻sourceからendまでを遅延としてstageに加え、
+//trace_fileを指定していれば[begin, end]をChromeのtrace形式(chrome://tracing, Perfetto)で書き出す
+//diagnostics_period[s]ごとに、その間の段階ごとのp50/p90/p99/maxとヒストグラムを/diagnosticsにpublishする
+//時刻はすべてros::Timeなので、ノードごとのtraceファイルは連結すれば1本の時間軸で見られる
+//header.seqはroscppがpublishのたびに付け直すので、どのscanのものかは元のscanのstamp(traceのargsの"scan")で対応させる
+class Latency_monitor
+{
+private:
+	struct Trace_event{
+		std::string stage;
+		double source;
+		double begin;
+		double end;
+	};
+
+	std::string name;
+	int pid;
+	std::mutex mtx;
+	//段階ごとの直近diagnostics_periodの遅延[ms](最初に記録した順)
+	std::vector<std::string> stage_order;
+	std::map<std::string, std::vector<double> > samples;
+	std::vector<Trace_event> events;
+	std::ofstream trace;
+	bool first_event;
+
+	ros::Publisher diagnostics_pub;
+	ros::Timer timer;
+
+	int get_tid(const std::string&) const;
+	void write_metadata(const char*, int, const std::string&);
+	void write_event(const Trace_event&);
+	void publish(const ros::TimerEvent&);
+
+public:
+	Latency_monitor(void);
+	~Latency_monitor(void);
+	void init(ros::NodeHandle&, ros::NodeHandle&, const std::string&);
+	void record(const std::string&, const ros::Time&, const ros::Time&, const ros::Time&);
+	//begin = end(その時点までの遅延だけを記録する)
+	void record(const std::string&, const ros::Time&, const ros::Time&);
+};
+
+#endif
@@ -0,0 +1,48 @@
+#ifndef CHIBI19_A_LATEST_BUFFER_H
+#define CHIBI19_A_LATEST_BUFFER_H
+
+#include <atomic>
+
+//書き込み側と読み出し側の2つのスレッドの間で、最新の値だけを受け渡すバッファ(3面、ロックなし)
+//書き込み側はget_back()に書いてからpublish()、読み出し側はupdate()してからget_front()を読む
+//どちらも相手を待たない。読まれる前に次が書かれたら古い方は捨てる
+template<typename T>
+class Latest_buffer
+{
+private:
+	static const int FRESH = 4;
+	T buffers[3];
+	//書き込み側と読み出し側の間にある面の番号(まだ読まれていなければFRESHを立てる)
+	std::atomic<int> middle;
+	int back;
+	int front;
+
+public:
+	Latest_buffer(void) : middle(1), back(0), front(2) {}
+
+	T& get_back(void)
+	{
+		return buffers[back];
+	}
+
+	void publish(void)
+	{
+		back = middle.exchange(back | FRESH) & ~FRESH;
+	}
+
+	//新しい値があればfrontと入れ替えてtrue
+	bool update(void)
+	{
+		if(!(middle.load() & FRESH))
+			return false;
+		front = middle.exchange(front) & ~FRESH;
+		return true;
+	}
+
+	const T& get_front(void) const
+	{
+		return buffers[front];
+	}
+};
+
+#endif
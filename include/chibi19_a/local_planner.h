@@ -0,0 +1,345 @@
+#ifndef CHIBI19_A_LOCAL_PLANNER_H
+#define CHIBI19_A_LOCAL_PLANNER_H
+
+#include <string>
+#include <vector>
+#include <random>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <chrono>
+#include <istream>
+#include <ostream>
+#include "chibi19_a/scan_filter.h"
+
+struct Speed{
+	double v;
+	double omega;
+};
+
+struct Position{
+	double x;
+	double y;
+	double yaw;
+};
+
+struct Status{
+	double x;
+	double y;
+	double yaw;
+	double v;
+	double omega;
+};
+
+//a_starのnav_function(NavigationFunction.msgと同じ並び、dataはx + width*y)
+struct Nav_grid{
+	double resolution;
+	double origin_x;
+	double origin_y;
+	int width;
+	int height;
+	std::vector<float> data;
+};
+
+//dwa.yamlのうち局所経路計画が使うもの(初期値はdwa.yamlと同じ)
+struct Local_planner_params{
+	double dt;
+	double dv;
+	double dyaw;
+	double min_speed;
+	double max_accel;
+	double limit_speed;
+	double max_dyawrate;
+	double limit_yawrate;
+	double predict_time;
+	double roomba_radius;
+	double l_ob_cost_gain;
+	double to_g_goal_cost_gain;
+	double nav_cost_gain;
+	double path_cost_gain;
+	double heading_cost_gain;
+	double speed_cost_gain;
+	double smoothness_cost_gain;
+	bool use_nav_function;
+	bool print_cost_breakdown;
+	double ob_grid_resolution;
+	double ob_dist_max;
+	int num_threads;
+	//dwa or mppi
+	std::string controller;
+	//library or batch
+	std::string rollout_mode;
+	//grid or arc
+	std::string clearance_mode;
+	//lattice or adaptive
+	std::string sampling_mode;
+	double time_budget;
+	int mppi_samples;
+	double mppi_lambda;
+	double mppi_sigma_v;
+	double mppi_sigma_omega;
+	//初期値はdwa.yamlと同じ支柱のマスク
+	Scan_filter_params scan_filter;
+
+	Local_planner_params(void);
+};
+
+//(v, omega)の格子点ごとのlocal軌道をまとめて持つ
+//軌道はv, omega, dt, predict_timeだけで決まるので、起動時に一度計算すれば毎周期同じものを使える
+//v = v_min + v_i*dv, omega = (omega_i - omega_offset)*dyaw
+struct Traj_library{
+	double v_min;
+	double dv;
+	double dyaw;
+	int v_size;
+	int omega_size;
+	int omega_offset;
+	int traj_size;
+	std::vector<Status> points;
+
+	void build(const Local_planner_params&, bool);
+	double v(const int v_i) const { return v_min + v_i*dv; }
+	double omega(const int omega_i) const { return (omega_i - omega_offset)*dyaw; }
+	const Status* get(const int v_i, const int omega_i) const
+	{
+		return &points[(v_i*omega_size + omega_i)*traj_size];
+	}
+};
+
+//scanから毎周期作る、ロボット中心(base_link)の障害物までの距離場
+//一辺は軌道の届く範囲+max_distなので、軌道上の点からmax_dist以内の障害物は必ず格子内にある
+struct Ob_grid{
+	double resolution;
+	double inv_resolution;
+	double max_dist;
+	double origin;
+	int size;
+	std::vector<float> dist;
+	std::vector<int> nearest;
+	std::vector<Position> points;
+	//scan点をbucket_sizeの粗い格子ごとに並べ直したもの(bucket bの点はbucket_start[b]からbucket_start[b+1]の手前まで)
+	double bucket_size;
+	int bucket_count;
+	std::vector<int> bucket_start;
+	std::vector<Position> bucket_points;
+
+	void init(double, double, double);
+	void update(const Filtered_scan&);
+	void relax(int, int);
+	void sort_buckets(void);
+	int bucket_index(double) const;
+	//(x, y)から最も近い障害物までの距離(max_distで打ち切り)
+	double clearance(const double x, const double y) const
+	{
+		double fx = (x - origin)*inv_resolution;
+		double fy = (y - origin)*inv_resolution;
+		if(!(fx >= 0.0 && fx < size && fy >= 0.0 && fy < size)) return max_dist;
+		return dist[int(fx) + size*int(fy)];
+	}
+};
+
+//サンプル評価を分担する常駐スレッド
+//run(f)はf(0)を呼び出し元で、f(1)...f(size-1)を各スレッドで実行して全部終わるまで待つ
+class Worker_pool
+{
+private:
+	std::vector<std::thread> threads;
+	std::mutex mtx;
+	std::condition_variable work_cv;
+	std::condition_variable done_cv;
+	const std::function<void(int)>* job;
+	unsigned long generation;
+	int pending;
+	bool stopping;
+
+	void loop(int, unsigned long);
+
+public:
+	Worker_pool(void);
+	~Worker_pool(void);
+	void start(int);
+	void stop(void);
+	void run(const std::function<void(int)>&);
+	int size(void) const;
+};
+
+template<typename... Terms>
+struct Cost_pipeline;
+
+//DWA(またはMPPI)の局所経路計画(ROSに依存しない)
+//gpathとnav_functionを渡しておき、毎周期scanと現在の状態(global)から出力速度を求める
+class Local_planner
+{
+private:
+	//1周期の間変わらない追従の情報(現在位置とその回転、gpath上の目標点)
+	//サンプルごとのコストは終端をglobalに直して目標点やコスト場と比べるだけになる
+	struct Tracking_context{
+		const Local_planner* planner;
+		Status g_roomba;
+		double s;
+		double c;
+		Position g_goal;
+		//gpath上の最近点と、そこから目標点へ向かう向き
+		Position g_path_point;
+		bool use_nav;
+	};
+
+	//評価する1本の軌道(v, omegaは一定)
+	//trajがあれば障害物のコストは軌道の各点で距離場を引き、なければ(batch)積分中に求めたmin_distを使う
+	struct Rollout_sample{
+		double v;
+		double omega;
+		Status l_last;
+		const Status* traj;
+		int traj_size;
+		double min_dist;
+	};
+
+	//候補をLANES本まとめて、SoAで同時に積分しながら障害物と目標点のコストを求める
+	struct Rollout_batch{
+		static const int LANES = 8;
+		int size;
+		double v[LANES];
+		double omega[LANES];
+		double cost[LANES];
+
+		void evaluate(const Tracking_context&, int);
+	};
+
+	struct Sample_result{
+		double cost;
+		int index;
+	};
+
+	//dynamic windowに含まれる格子点(通し番号はv_iの順、同じv_iの中はomegaの順)
+	struct Sample_window{
+		int min_v_i;
+		int min_omega_i;
+		int n_v;
+		int n_omega;
+
+		int size(void) const { return n_v*n_omega; }
+		int v_i(const int index) const { return min_v_i + index/n_omega; }
+		int y_i(const int index) const { return min_omega_i + index%n_omega; }
+	};
+
+	//評価関数の各項
+	struct Goal_term;
+	struct Path_term;
+	struct Heading_term;
+	struct Speed_term;
+	struct Smoothness_term;
+	struct Clearance_term;
+	typedef Cost_pipeline<Goal_term, Path_term, Heading_term, Speed_term, Smoothness_term, Clearance_term> Dwa_cost;
+
+	//MPPI (Model Predictive Path Integral)
+	class Mppi
+	{
+	private:
+		int samples;
+		int horizon;
+		double lambda;
+		double sigma_v;
+		double sigma_omega;
+		std::vector<double> u_v;
+		std::vector<double> u_omega;
+		//ステップkのサンプルiは[k*samples + i]
+		std::vector<double> eps_v;
+		std::vector<double> eps_omega;
+		std::vector<double> x;
+		std::vector<double> y;
+		std::vector<double> yaw;
+		std::vector<double> min_dist;
+		std::vector<double> cost;
+		std::mt19937 rng;
+
+	public:
+		void init(const Local_planner_params&);
+		Speed control(Local_planner&, const Tracking_context&);
+		int get_samples(void) const;
+	};
+
+	Local_planner_params params;
+	//params.rollout_mode, clearance_modeはinitで一度だけ解釈する(サンプルごとに文字列を比べない)
+	bool batch_rollout;
+	bool arc_clearance;
+	Traj_library traj_library;
+	Scan_filter scan_filter;
+	Filtered_scan filtered_scan;
+	Ob_grid ob_grid;
+	Worker_pool worker_pool;
+	Mppi mppi;
+	std::vector<Position> g_path;
+	Nav_grid nav_function;
+	//前周期の最近点の周りだけを探す(離れすぎたときは全体を探し直す)
+	int g_path_cursor;
+	bool can_goal;
+	Position g_goal;
+	//前周期に選んだ速度(warm startに使う)
+	Speed prev_output;
+	bool has_prev_output;
+	std::vector<Status> best_traj;
+	int samples;
+	int pruned;
+
+	void to_global(const Tracking_context&, const Status&, double&, double&) const;
+	double calc_to_g_goal_cost(const Tracking_context&, const Status&) const;
+	Position find_g_path_target(const Status&);
+	double nav_function_value(double, double) const;
+	double calc_nav_cost(const Tracking_context&, const Status&) const;
+	void build_tracking_context(Tracking_context&, const Status&);
+	double calc_l_ob_cost(const Status*, int) const;
+	double calc_arc_clearance(double, double, double) const;
+	double calc_arc_ob_cost(double, double) const;
+	Rollout_sample library_sample(int, int) const;
+	double evaluate_sample(const Tracking_context&, int, int) const;
+	double evaluate_candidate(const Tracking_context&, int, int) const;
+	Sample_result search_lattice(const Tracking_context&, const Sample_window&);
+	Sample_result search_adaptive(const Tracking_context&, const Sample_window&, std::chrono::steady_clock::time_point);
+	void print_cost(const Tracking_context&, const Rollout_sample&) const;
+	void log_best_traj(const Status*, int);
+	Speed dwa_control(const Tracking_context&);
+
+public:
+	Local_planner(void);
+	void init(const Local_planner_params&);
+	//新しいgpath(最近点は最初から探し直す)
+	void set_path(const std::vector<Position>&);
+	void set_nav_function(const Nav_grid&);
+	//goalに着いた扱いをやめて、gpathの追従をやり直す
+	void reset_goal(void);
+	//scanを前処理して距離場を作り、現在の状態(global)から出力速度を求める
+	Speed control(const Status&, const Scan&);
+	bool get_can_goal(void) const;
+	//gpath上の追従している目標点(global)
+	Position get_target(void) const;
+	//選んだ軌道(local)
+	const std::vector<Status>& get_best_traj(void) const;
+	//直前のcontrolで評価したサンプル数(下限で打ち切ったものは含まない)
+	int get_samples(void) const;
+	//直前のcontrolで障害物のコストの下限だけで打ち切ったサンプル数
+	int get_pruned(void) const;
+	const Local_planner_params& get_params(void) const;
+	const Traj_library& get_traj_library(void) const;
+};
+
+//replay用の記録(1行1件のテキスト)
+//path n x y yaw ...
+//reset_goal
+//cycle x y yaw v omega angle_min angle_increment range_min range_max n r ...
+struct Replay_frame{
+	bool new_path;
+	bool reset_goal;
+	std::vector<Position> path;
+	Status roomba;
+	Scan scan;
+};
+
+void write_replay_path(std::ostream&, const std::vector<Position>&);
+void write_replay_reset_goal(std::ostream&);
+void write_replay_cycle(std::ostream&, const Status&, const Scan&);
+//次のcycleまで読む(途中のpathはframe.pathに入れてnew_pathを、reset_goalがあればreset_goalを立てる)
+bool read_replay_frame(std::istream&, Replay_frame&);
+
+#endif
@@ -0,0 +1,166 @@
+#ifndef CHIBI19_A_LOCALIZATION_NODE_H
+#define CHIBI19_A_LOCALIZATION_NODE_H
+
+#include<ros/ros.h>
+#include<sensor_msgs/LaserScan.h>
+#include<std_msgs/Bool.h>
+#include<nav_msgs/OccupancyGrid.h>
+#include<geometry_msgs/PoseWithCovarianceStamped.h>
+#include<geometry_msgs/PoseStamped.h>
+#include<geometry_msgs/PointStamped.h>
+#include<geometry_msgs/Pose2D.h>
+#include<tf/transform_broadcaster.h>
+#include<tf/transform_listener.h>
+#include<ros/callback_queue.h>
+#include<queue>
+#include<atomic>
+#include<boost/shared_ptr.hpp>
+#include "chibi19_a/scan_filter.h"
+#include "chibi19_a/latest_buffer.h"
+#include "chibi19_a/latency_monitor.h"
+
+class OdomData
+{
+public:
+	geometry_msgs::Pose2D pose;
+	geometry_msgs::Pose2D delta;
+
+};
+
+class CellData
+{
+public:
+	unsigned int i_f, j_f;
+	unsigned int i_o, j_o;
+	//積んだときのi_f, j_fのocc_dist(積んだ後は変わらない)
+	double dist;
+};
+
+class Particle
+{
+public:
+	Particle(void);
+	geometry_msgs::Pose2D p_data;
+
+	double w;
+};
+
+//localizationノード(実行ファイルとnodeletで共通)
+//状態はすべてメンバに持ち、10Hzのタイマでパーティクルを更新する
+//scanはsensor_queue、map・初期位置・白線検知はcontrol_queueでそれぞれ別のスレッドが受け取り、
+//フィルタ(タイマ)には最新の値だけをLatest_bufferで渡すので、受け取り側はフィルタの計算を待たない
+class Localization
+{
+private:
+	//前処理済みのscan(sensor_queueのスレッドで作る)
+	struct Laser_data{
+		ros::Time stamp;
+		Filtered_scan scan;
+	};
+
+	ros::CallbackQueue sensor_queue;
+	ros::CallbackQueue control_queue;
+
+	//map, occ_dist, costはcontrol_queueのスレッドで一度だけ作り、map_receivedを立てた後は書き換えない
+	nav_msgs::OccupancyGrid::ConstPtr map;
+	//mapから一度だけ作り、毎周期同じものをpublishする
+	nav_msgs::OccupancyGrid::Ptr cost;
+	std::vector<double> occ_dist;
+	std::atomic<bool> map_received;
+	Latest_buffer<Laser_data> laser_buffer;
+	Latest_buffer<geometry_msgs::Pose2D> init_pose_buffer;
+	std::atomic<bool> line_detection;
+	//sensor_queueのスレッドだけが使う
+	Scan raw_scan;
+	Scan_filter scan_filter;
+
+	//ここから下はフィルタ(タイマ)のスレッドだけが使う
+	geometry_msgs::PoseStamped estimated_pose;
+	bool has_laser;
+
+	int N;
+	double init_x;
+	double init_y;
+	double init_theta;
+	double init_x_cov;
+	double init_y_cov;
+	double init_theta_cov;
+	double x_cov;
+	double y_cov;
+	double theta_cov;
+	double x_cov_thresh;
+	double y_cov_thresh;
+	double alpha_slow;
+	double alpha_fast;
+	double motion_update;
+	double angle_update;
+	double motion;
+	double angle;
+	double w_slow;
+	double w_fast;
+
+	double alpha1;
+	double alpha2;
+	double alpha3;
+	double alpha4;
+
+	double z_hit;
+	double z_rand;
+	double sigma_hit;
+	double laser_likelihood_max_dist;
+
+	bool init_set;
+	bool use_init_pose;
+
+	std::vector<Particle> p_cloud;
+
+	geometry_msgs::PointStamped line_pose;
+	double check_motion;
+	int pose_count;
+
+	ros::NodeHandle nh_;
+	ros::Publisher pose_pub;
+	ros::Publisher poses_pub;
+	ros::Publisher cost_pub;
+	ros::Publisher line_pub;
+	ros::Subscriber laser_sub;
+	ros::Subscriber map_sub;
+	ros::Subscriber init_sub;
+	ros::Subscriber line_detection_sub;
+	ros::Timer timer;
+	Latency_monitor monitor;
+
+	tf::TransformListener listener;
+	tf::TransformBroadcaster map_br;
+	tf::StampedTransform latest_transform;
+	tf::StampedTransform previous_transform;
+
+	//コンストラクタの最後に作り、デストラクタで最初に止める
+	boost::shared_ptr<ros::AsyncSpinner> sensor_spinner;
+	boost::shared_ptr<ros::AsyncSpinner> control_spinner;
+
+	int map_index(int, int) const;
+	int map_grid(double) const;
+	bool map_valid(int, int) const;
+	void enqueue(int, int, int, int, std::priority_queue<CellData>&, unsigned char*, int);
+	void map_update_cspace(void);
+	void init_particles(double, double, double);
+	void init_particle(Particle&, double, double, double, double, double, double);
+	void move(Particle&, const OdomData&);
+	void sense(Particle&);
+	void resample(double);
+	void estimate_pose(void);
+	void filter_update(void);
+	void publish_particles(void);
+	void update(const ros::TimerEvent&);
+
+public:
+	Localization(ros::NodeHandle, ros::NodeHandle);
+	~Localization(void);
+	void LaserCallback(const sensor_msgs::LaserScanConstPtr& msg);
+	void MapCallback(const nav_msgs::OccupancyGridConstPtr& msg);
+	void InitPoseCallback(const geometry_msgs::PoseWithCovarianceStampedConstPtr& msg);
+	void LineDetectionCallback(const std_msgs::Bool::ConstPtr& msg);
+};
+
+#endif
@@ -0,0 +1,46 @@
+#ifndef CHIBI19_A_MULTI_RESOLUTION_H
+#define CHIBI19_A_MULTI_RESOLUTION_H
+
+#include <vector>
+#include "chibi19_a/grid_cell.h"
+#include "chibi19_a/grid_search.h"
+
+//粗い格子上の帯に親セルが含まれるセルだけを許可する
+struct Corridor_mask{
+	const std::vector<std::vector<bool> >* mask;
+	int shift;
+
+	bool operator()(int x, int y) const
+	{
+		return (*mask)[x >> shift][y >> shift];
+	}
+};
+
+//粗い格子で経路を求めてから、その周囲の帯(corridor)の中だけを元の解像度で探索する
+//粗い格子は2x2の最大コストで縮小したピラミッドなので、粗い経路は障害物を跨がない
+//探索はどれもGrid_search(4近傍、manhattan、cost_map)で、帯はCorridor_maskで与える
+class Multi_resolution_planner
+{
+private:
+	typedef Grid_search<Four_connected, Manhattan_heuristic, Cost_map_cost> Full_search;
+	typedef Grid_search<Four_connected, Manhattan_heuristic, Cost_map_cost, Corridor_mask> Corridor_search;
+
+	const std::vector<std::vector<char> >* grid;
+	std::vector<std::vector<std::vector<char> > > levels;
+	std::vector<std::vector<bool> > mask;
+	//作業領域は格子の大きさごとに持つので、粗い格子と元の格子で分ける
+	Full_search coarse_search;
+	Full_search full_search;
+	Corridor_search corridor_search;
+	int expansions;
+
+public:
+	Multi_resolution_planner(void);
+	void build(const std::vector<std::vector<char> >&, int);
+	int get_levels(void) const;
+	//corridorは最も粗い格子でのセル数
+	bool search(Cell, Cell, int, std::vector<Cell>&);
+	int get_expansions(void) const;
+};
+
+#endif
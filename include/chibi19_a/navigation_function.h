@@ -0,0 +1,34 @@
+#ifndef CHIBI19_A_NAVIGATION_FUNCTION_H
+#define CHIBI19_A_NAVIGATION_FUNCTION_H
+
+#include <vector>
+#include "chibi19_a/grid_cell.h"
+
+//goalからのDijkstraで求めた各セルのgoalまでのコスト
+//startが確定してからmarginだけ広げた所で打ち切り、確定したセルの範囲だけを保持する
+class Navigation_function
+{
+private:
+	std::vector<float> field;
+	int min_x;
+	int min_y;
+	int width;
+	int height;
+	float bound;
+	Cell goal;
+
+public:
+	Navigation_function(void);
+	void compute(const std::vector<std::vector<char> >&, Cell, Cell, double);
+	//確定したセルは厳密値、それ以外は下界(打ち切り時のコスト)を返すのでA*のヒューリスティックに使える
+	float value(int, int) const;
+	bool is_exact(int, int) const;
+	int get_min_x(void) const;
+	int get_min_y(void) const;
+	int get_width(void) const;
+	int get_height(void) const;
+	Cell get_goal(void) const;
+	const std::vector<float>& get_field(void) const;
+};
+
+#endif
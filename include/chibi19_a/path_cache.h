@@ -0,0 +1,32 @@
+#ifndef CHIBI19_A_PATH_CACHE_H
+#define CHIBI19_A_PATH_CACHE_H
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include <unordered_map>
+#include "chibi19_a/grid_cell.h"
+
+//区間ごとの経路をファイルに保存しておき、次回起動時に探索を省く
+//キーは(地図の内容のハッシュ, 量子化したstart/goal, 探索パラメータ)
+//ファイルは先頭セルと、以降の1歩ごとの移動方向(1byte)だけを持つ
+class Path_cache
+{
+private:
+	std::string filename;
+	std::unordered_map<uint64_t, std::vector<Cell> > entries;
+
+public:
+	static uint64_t hash_grid(const std::vector<std::vector<char> >&, double, double, double);
+	static uint64_t make_key(uint64_t, Cell, Cell, int, const std::string&);
+
+	bool load(const std::string&);
+	bool save(void) const;
+	//保存されていた経路を現在の地図で確認し、start/goalまで直線でつないで返す
+	//start/goal以外にmax_cost(視線判定と同じlos_max_cost)を超えるセルがあれば使わない
+	bool find(uint64_t, const std::vector<std::vector<char> >&, Cell, Cell, int, std::vector<Cell>&) const;
+	void insert(uint64_t, const std::vector<Cell>&);
+	int size(void) const;
+};
+
+#endif
@@ -0,0 +1,15 @@
+#ifndef CHIBI19_A_ROUTE_OPTIMIZER_H
+#define CHIBI19_A_ROUTE_OPTIMIZER_H
+
+#include <vector>
+#include "chibi19_a/grid_cell.h"
+
+//points[i]から全てのpointsへの経路コストを、始点ごとに1回のDijkstraで求める
+void calc_cost_matrix(const std::vector<std::vector<char> >&, const std::vector<Cell>&, std::vector<std::vector<double> >&);
+//0番を始点・終点とする巡回路の総コスト
+double tour_cost(const std::vector<std::vector<double> >&, const std::vector<int>&);
+//0番から出発して全点を巡り0番に戻る順番を求める(orderは0から始まり、戻りの0は含まない)
+//点数が少なければHeld-Karpで厳密解、多ければ最近傍法の初期解を2-opt/Or-optで改善する
+bool solve_tour(const std::vector<std::vector<double> >&, std::vector<int>&);
+
+#endif
@@ -0,0 +1,65 @@
+#ifndef CHIBI19_A_SCAN_FILTER_H
+#define CHIBI19_A_SCAN_FILTER_H
+
+#include <vector>
+
+//LaserScanのうち前処理が使う部分(角度はbase_link)
+struct Scan{
+	double angle_min;
+	double angle_increment;
+	double range_min;
+	double range_max;
+	std::vector<float> ranges;
+};
+
+struct Scan_filter_params{
+	//センサのrange_min, range_maxをさらに狭める[m](0以下なら狭めない)
+	double min_range;
+	double max_range;
+	//使わない角度の範囲[rad]を[min, max]の組で並べたもの(ロボット自身の支柱など)
+	std::vector<double> mask;
+	//beam_step本に1本だけ使う、max_beams(0なら制限なし)本を超えるときはさらに間引く
+	int beam_step;
+	int max_beams;
+
+	Scan_filter_params(void);
+};
+
+//前処理後の1本(c, sはbase_linkでのビームの向きの単位ベクトル)
+struct Beam{
+	double range;
+	double c;
+	double s;
+};
+
+//range_min < range < range_maxで、マスクの外にある間引いた後のビームだけを持つ
+struct Filtered_scan{
+	double range_min;
+	double range_max;
+	std::vector<Beam> beams;
+};
+
+//scanが来るたびに一度だけ通す前処理
+//マスクと間引きで残るビームとその単位ベクトルは、scanの角度と本数が変わったときだけ作り直す
+class Scan_filter
+{
+private:
+	Scan_filter_params params;
+	double angle_min;
+	double angle_increment;
+	int size;
+	std::vector<int> indices;
+	std::vector<double> c;
+	std::vector<double> s;
+
+	bool is_masked(double) const;
+	void build(const Scan&);
+
+public:
+	Scan_filter(void);
+	void init(const Scan_filter_params&);
+	void apply(const Scan&, Filtered_scan&);
+	const Scan_filter_params& get_params(void) const;
+};
+
+#endif
@@ -0,0 +1,53 @@
+#ifndef CHIBI19_A_THETA_STAR_H
+#define CHIBI19_A_THETA_STAR_H
+
+#include <vector>
+#include <unordered_map>
+#include "chibi19_a/grid_cell.h"
+
+//aからbへの直線が通るセルを順に追加する(a, bを含む)
+void trace_line(Cell, Cell, std::vector<Cell>&);
+//直線a-bのコスト。max_costを超えるセルを通る場合は視線が通らないとしてINF
+double line_cost(const std::vector<std::vector<char> >&, Cell, Cell, int);
+bool line_of_sight(const std::vector<std::vector<char> >&, Cell, Cell, int);
+//頂点列を直線でつないだセル列に戻す
+void expand_path(const std::vector<Cell>&, std::vector<Cell>&);
+//視線が通りコストが悪化しない範囲で頂点を飛ばし、最小限の頂点列にする
+void shortcut_path(const std::vector<std::vector<char> >&, const std::vector<Cell>&, std::vector<Cell>&, int);
+//区間(waypoint間)ごとにshortcut_pathしてつなぐ。区間の端点(waypoint)は必ず頂点に残るので、
+//周回や往復の経路でも途中のwaypointを飛ばさない
+void shortcut_segments(const std::vector<std::vector<char> >&, const std::vector<std::vector<Cell> >&, std::vector<Cell>&, int);
+
+//Theta* (any-angle A*)
+//親ノードから視線が通れば親に直接つなぐので、格子に沿わない最短経路が得られる
+class Theta_star
+{
+private:
+	struct Node{
+		double g;
+		int parent;
+		bool closed;
+	};
+
+	struct Entry{
+		double f;
+		int id;
+		double g;
+	};
+
+	struct EntryCompare{
+		bool operator()(const Entry& a, const Entry& b) const;
+	};
+
+	std::unordered_map<int, Node> nodes;
+	int los_max_cost;
+	int expansions;
+
+public:
+	Theta_star(void);
+	void set_los_max_cost(int);
+	bool search(const std::vector<std::vector<char> >&, Cell, Cell, std::vector<Cell>&);
+	int get_expansions(void) const;
+};
+
+#endif
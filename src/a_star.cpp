@@ -1,79 +1,164 @@
-#include "ros/ros.h"
+#include "chibi19_a/a_star_node.h"
 #include "tf/transform_datatypes.h"
-#include "nav_msgs/Path.h"
-#include "nav_msgs/OccupancyGrid.h"
-#include "geometry_msgs/PoseStamped.h"
-
-bool map_received = false;
-bool initflag = false;
-bool setWP = false;
-
-struct waypoint{
-	double x;
-	double y;
-};
-
-struct Open{
-	int f;
-	int g;
-	int h;
-	int x;
-	int y;
-};
-
-class A_star
+#include <chrono>
+#include <sstream>
+#include <boost/make_shared.hpp>
+#include "chibi19_a/theta_star.h"
+#include "chibi19_a/route_optimizer.h"
+#include "chibi19_a/NavigationFunction.h"
+
+namespace
 {
-private:
-	nav_msgs::Path roomba_gpath;
-	nav_msgs::Path samp_path;
-	geometry_msgs::PoseStamped roomba_status;
-	nav_msgs::OccupancyGrid map;
-	std::vector<std::vector<char> > grid;
-	std::vector<std::vector<int> > heuristic;
-	std::vector<int> init;
-	std::vector<int> goal;
-
-	unsigned int map_row;
-	unsigned int map_col;
-
-	ros::NodeHandle nh;
-	ros::Publisher roomba_gpath_pub;
-	ros::Subscriber map_sub;
-	ros::Subscriber cost_sub;
-	ros::Subscriber roomba_status_sub;
-
-public:
-	A_star(void);
-	void map_callback(const nav_msgs::OccupancyGrid::ConstPtr& msg);
-	void cost_callback(const nav_msgs::OccupancyGrid::ConstPtr& msg);
-	void amcl_callback(const geometry_msgs::PoseStamped::ConstPtr& msg);
-	void set_waypoint(int, std::vector<waypoint>&);
-	void get_heuristic(int, int);
-	bool search_path(float, float, float, float);
-	void pub_path(void);
-	void sampling_path(void);
-};
-
-A_star::A_star(void)
+double xmlrpc_to_double(XmlRpc::XmlRpcValue& value)
+{
+	if(value.getType() == XmlRpc::XmlRpcValue::TypeInt)
+		return static_cast<int>(value);
+	return static_cast<double>(value);
+}
+
+//waypoints: [[x, y], ...]を読む。無ければ旧形式のwx1, wy1, wx2, ...を読む
+void load_waypoints(ros::NodeHandle& private_nh, std::vector<waypoint>& waypoints)
+{
+	XmlRpc::XmlRpcValue list;
+	waypoint wp;
+
+	waypoints.clear();
+	if(private_nh.getParam("waypoints", list) && list.getType() == XmlRpc::XmlRpcValue::TypeArray){
+		for(int i = 0; i < list.size(); i++){
+			if(list[i].getType() != XmlRpc::XmlRpcValue::TypeArray || list[i].size() < 2){
+				ROS_WARN("waypoints[%d] is not [x, y]", i);
+				continue;
+			}
+			wp.x = xmlrpc_to_double(list[i][0]);
+			wp.y = xmlrpc_to_double(list[i][1]);
+			waypoints.push_back(wp);
+		}
+		return;
+	}
+
+	for(int i = 1; ; i++){
+		std::string wx = "wx" + std::to_string(i);
+		std::string wy = "wy" + std::to_string(i);
+		if(!private_nh.hasParam(wx) || !private_nh.hasParam(wy))
+			break;
+		private_nh.param(wx, wp.x, 0.0);
+		private_nh.param(wy, wp.y, 0.0);
+		waypoints.push_back(wp);
+	}
+}
+}
+
+A_star::A_star(ros::NodeHandle n, ros::NodeHandle private_nh) : nh(n)
 {
 	roomba_gpath_pub = nh.advertise<nav_msgs::Path>("gpath", 1);
+	nav_function_pub = nh.advertise<chibi19_a::NavigationFunction>("nav_function", 1, true);
 	map_sub = nh.subscribe("map", 1, &A_star::map_callback,this);
 	cost_sub = nh.subscribe("cost_map", 1, &A_star::cost_callback,this);
 	roomba_status_sub = nh.subscribe("amcl_pose", 1, &A_star::amcl_callback, this);
+	blocked_sub = nh.subscribe("blocked_cell", 10, &A_star::blocked_callback, this);
 	roomba_gpath.header.frame_id = "map";
-	samp_path.header.frame_id = "map";
+	samp_path.reset(new nav_msgs::Path);
+	samp_path->header.frame_id = "map";
 
 	init.resize(2);
 	goal.resize(2);
 
+	private_nh.param("planner", planner, std::string("a_star"));
+	private_nh.param("block_radius", block_radius, 0.3);
+	private_nh.param("path_sampling", path_sampling, std::string("fixed"));
+	private_nh.param("pose_interval", pose_interval, 0.4);
+	private_nh.param("los_max_cost", los_max_cost, 90);
+	private_nh.param("time_budget", time_budget, 0.1);
+	private_nh.param("initial_epsilon", initial_epsilon, 3.0);
+	private_nh.param("epsilon_step", epsilon_step, 0.5);
+	private_nh.param("optimize_route", optimize_route, false);
+	private_nh.param("heuristic", heuristic_type, std::string("manhattan"));
+	private_nh.param("nav_margin", nav_margin, 3.0);
+	private_nh.param("nav_goal_tolerance", nav_goal_tolerance, 1.0);
+	private_nh.param("resolution_levels", resolution_levels, 2);
+	private_nh.param("corridor_width", corridor_width, 1.0);
+	private_nh.param("neighborhood", neighborhood, 4);
+	private_nh.param("cost_model", cost_model, std::string("cost_map"));
+	if(!is_admissible(neighborhood, heuristic_type))
+		ROS_ERROR("heuristic %s overestimates diagonal moves with neighborhood %d", heuristic_type.c_str(), neighborhood);
+	grid_search.reset(create_grid_search(neighborhood, heuristic_type, cost_model, &nav_function));
+	if(!grid_search){
+		ROS_ERROR("invalid search kernel (neighborhood %d, heuristic %s, cost_model %s), use 4/manhattan/cost_map",
+				neighborhood, heuristic_type.c_str(), cost_model.c_str());
+		neighborhood = 4;
+		heuristic_type = "manhattan";
+		cost_model = "cost_map";
+		grid_search.reset(create_grid_search(neighborhood, heuristic_type, cost_model, &nav_function));
+	}
+	private_nh.param("use_path_cache", use_path_cache, false);
+	private_nh.param("path_cache_quantum", path_cache_quantum, 0.2);
+	if(use_path_cache){
+		std::string path_cache_file;
+		//相対パスはROS_HOME(通常~/.ros)からになる
+		private_nh.param("path_cache_file", path_cache_file, std::string("chibi19_a_path_cache.bin"));
+		if(path_cache.load(path_cache_file))
+			ROS_INFO("path cache: %d segments loaded from %s", path_cache.size(), path_cache_file.c_str());
+	}
+	map_hash = 0;
+	path_published = false;
+	nav_target = 1;
+	nav_dirty = true;
+	map_received = false;
+	initflag = false;
+	setWP = false;
+	count = 0;
+
+	monitor.init(nh, private_nh, "a_star");
+
+	load_waypoints(private_nh, waypoints);
+	waycount = waypoints.size();
+	if(waypoints.empty()){
+		ROS_ERROR("no waypoints");
+		return;
+	}
+	timer = nh.createTimer(ros::Duration(0.1), &A_star::update, this);
+}
+
+int A_star::get_waypoint_count(void) const
+{
+	return waycount;
+}
+
+void A_star::update(const ros::TimerEvent&)
+{
+	if(initflag && map_received && !setWP){
+		set_waypoint(waycount, waypoints);
+		setWP = true;
+	}
+	if(map_received && setWP && count < waycount+1){
+		if(search_path(waypoints[count].x, waypoints[count].y, waypoints[count+1].x, waypoints[count+1].y)){
+				//pub_path();
+				count++;
+				//間引きは全区間がそろってから一度だけ
+				if(count == waycount+1)
+					sampling_path();
+		}
+	}
+	if(count == waycount +1){
+		ros::Time begin = ros::Time::now();
+
+		pub_path();
+		refine_path();
+		update_nav_function(waypoints);
+		//経路の修正はcurrent_poseを使うので、その元のscanからの遅延にする
+		if(current_pose)
+			monitor.record("plan", current_pose->header.stamp, begin, ros::Time::now());
+	}
 }
 
 void A_star::amcl_callback(const geometry_msgs::PoseStamped::ConstPtr& msg)
 {
+	current_pose = msg;
+	monitor.record("pose_receive", msg->header.stamp, ros::Time::now());
 	if(initflag)
 		return;
 
-	roomba_status = *msg;
+	roomba_status = msg;
 	initflag =true;
 }
 
@@ -94,16 +179,31 @@ void A_star::map_callback(const nav_msgs::OccupancyGrid::ConstPtr& msg)
 		}
 	}
 
-	heuristic = std::vector<std::vector<int> >(map_row, std::vector<int>(map_col, 0));
-
 	map_received = true;
 */}
 
 void A_star::cost_callback(const nav_msgs::OccupancyGrid::ConstPtr& msg)
 {
-	if(map_received)
+	if(map_received){
+		//D* Liteのときは差分だけ反映して経路を修復する
+		if(planner != "d_star_lite" || msg->data.size() != map.data.size())
+			return;
+
+		std::vector<Cell> changed;
+		for(int i = 0; i < msg->data.size(); i++){
+			if(msg->data[i] == map.data[i] || blocked[i])
+				continue;
+			map.data[i] = msg->data[i];
+			Cell c = {(int)(i % map_row), (int)(i / map_row)};
+			grid[c.x][c.y] = map.data[i];
+			changed.push_back(c);
+		}
+		if(!changed.empty())
+			repair_path(changed);
 		return;
+	}
 	ROS_INFO("map received");
+	//blocked_cellとD* Liteの差分で書き換えるので、最初の1回だけ複製して持つ
 	map = *msg;
 
 	map_row = map.info.height;
@@ -116,16 +216,60 @@ void A_star::cost_callback(const nav_msgs::OccupancyGrid::ConstPtr& msg)
 		}
 	}
 
-	heuristic = std::vector<std::vector<int> >(map_row, std::vector<int>(map_col, 0));
+	blocked = std::vector<bool>(map.data.size(), false);
+	if(use_path_cache)
+		map_hash = Path_cache::hash_grid(grid, map.info.resolution, map.info.origin.position.x, map.info.origin.position.y);
+	if(planner == "multi_resolution")
+		multi_resolution.build(grid, resolution_levels);
 
 	map_received = true;
 }
 
+//指定された点の周囲block_radiusを障害物にする(以降のcost_mapでも上書きされない)
+void A_star::blocked_callback(const geometry_msgs::PointStamped::ConstPtr& msg)
+{
+	if(!map_received)
+		return;
+
+	double res = map.info.resolution;
+	int cx = floor((msg->point.x - map.info.origin.position.x) / res);
+	int cy = floor((msg->point.y - map.info.origin.position.y) / res);
+	int r = ceil(block_radius / res);
+	std::vector<Cell> changed;
+
+	for(int dx = -r; dx <= r; dx++){
+		for(int dy = -r; dy <= r; dy++){
+			int x = cx + dx;
+			int y = cy + dy;
+			if(dx*dx + dy*dy > r*r || x < 0 || x >= map_row || y < 0 || y >= map_col)
+				continue;
+			int i = x + map_row*y;
+			blocked[i] = true;
+			if(grid[x][y] == 100)
+				continue;
+			grid[x][y] = 100;
+			map.data[i] = 100;
+			Cell c = {x, y};
+			changed.push_back(c);
+		}
+	}
+	ROS_INFO("blocked %d cells", (int)changed.size());
+
+	if(planner == "d_star_lite" && !changed.empty())
+		repair_path(changed);
+}
+
 void A_star::set_waypoint(int waycount, std::vector<waypoint>& waypoints)
 {
+	if(optimize_route){
+		if(optimize_waypoint(waypoints))
+			return;
+		ROS_WARN("route optimization failed, keep waypoint order");
+	}
+
 	std::vector<waypoint> new_waypoints(waycount+2);
-	new_waypoints[0].x = roomba_status.pose.position.x;
-	new_waypoints[0].y = roomba_status.pose.position.y;
+	new_waypoints[0].x = roomba_status->pose.position.x;
+	new_waypoints[0].y = roomba_status->pose.position.y;
 	
 	float min_dist = INFINITY;
 	int next = 0;
@@ -155,14 +299,38 @@ void A_star::set_waypoint(int waycount, std::vector<waypoint>& waypoints)
 
 }
 
-void A_star::get_heuristic(int gx, int gy)
+//現在位置と全waypoint間の経路コストを求め、総コスト最小の巡回順に並べ替える
+bool A_star::optimize_waypoint(std::vector<waypoint>& waypoints)
 {
-	for(int row = 0; row < map_row; row++){
-		for(int col = 0; col < map_col; col++){
-			heuristic[row][col] = fabs(gx - row) + fabs(gy - col);
-			//heuristic[row][col] = std::max(fabs(gx - row), fabs(gy - col));
-		}
+	double res = map.info.resolution;
+	double origin_x = map.info.origin.position.x;
+	double origin_y = map.info.origin.position.y;
+	std::vector<waypoint> points(1);
+	std::vector<Cell> cells;
+	std::vector<std::vector<double> > cost;
+	std::vector<int> order;
+
+	points[0].x = roomba_status->pose.position.x;
+	points[0].y = roomba_status->pose.position.y;
+	points.insert(points.end(), waypoints.begin(), waypoints.end());
+	for(int i = 0; i < points.size(); i++){
+		Cell c = {(int)floor((points[i].x - origin_x) / res), (int)floor((points[i].y - origin_y) / res)};
+		cells.push_back(c);
+	}
+
+	ros::WallTime begin = ros::WallTime::now();
+	calc_cost_matrix(grid, cells, cost);
+	if(!solve_tour(cost, order))
+		return false;
+	ROS_INFO("route optimized: %d waypoints, cost %.1f, %.2f ms", (int)waypoints.size(), tour_cost(cost, order), (ros::WallTime::now() - begin).toSec()*1000.0);
+
+	waypoints.clear();
+	for(int i = 0; i < order.size(); i++){
+		waypoints.push_back(points[order[i]]);
 	}
+	waypoints.push_back(points[0]);
+
+	return true;
 }
 
 bool A_star::search_path(float ix, float iy, float gx, float gy)
@@ -173,130 +341,299 @@ bool A_star::search_path(float ix, float iy, float gx, float gy)
 	goal[0] = floor((gx - map.info.origin.position.x) / map.info.resolution);
 	goal[1] = floor((gy - map.info.origin.position.y) / map.info.resolution);
 
-	get_heuristic(goal[0], goal[1]);
-
-	bool found = false;
-	bool resign = false;
-	int row = map.info.height;
-	int col = map.info.width;
-	int x = init[0];
-	int y = init[1];
-	int g = 0;
-	int h = heuristic[x][y];
-	int f = g + h;
-	int x2 = 0;
-	int y2 = 0;
-	int g2 = 0;
-	int h2 = 0;
-	int f2 = 0;
-	int cost = 1;
+	if(planner == "d_star_lite")
+		return search_path_d_star();
+	if(planner == "ara_star")
+		return search_path_ara_star();
+
+	Cell s = {init[0], init[1]};
+	Cell g = {goal[0], goal[1]};
+	std::vector<Cell> cells;
+	uint64_t key = 0;
+
+	//探索状態を持たない手法だけ、前回までの結果をファイルから使う
+	if(use_path_cache){
+		int quantum = std::max(1, (int)round(path_cache_quantum / map.info.resolution));
+		key = Path_cache::make_key(map_hash, s, g, quantum, cache_params());
+		if(path_cache.find(key, grid, s, g, los_max_cost, cells)){
+			ROS_INFO("segment %d: path cache hit", (int)segments.size());
+			add_segment(cells);
+			return true;
+		}
+	}
+
+	if(planner == "theta_star"){
+		if(!search_path_theta_star(s, g, cells))
+			return false;
+	}else if(planner == "multi_resolution"){
+		if(!search_path_multi_resolution(s, g, cells))
+			return false;
+	}else{
+		//goalからのDijkstraの結果をそのまま使う(探索はほぼ最適経路上のセルだけになる)
+		if(heuristic_type == "nav_function"){
+			nav_function.compute(grid, g, s, nav_margin / map.info.resolution);
+			nav_dirty = true;
+		}
+		if(!grid_search->search(grid, s, g, cells))
+			return false;
+	}
+
+	if(use_path_cache){
+		path_cache.insert(key, cells);
+		if(!path_cache.save())
+			ROS_WARN("failed to save path cache");
+	}
+	add_segment(cells);
+
+	//ROS_INFO("set path");
+	return true;
+}
+
+//キャッシュのキーに含める、経路の形を変えるパラメータ
+std::string A_star::cache_params(void)
+{
+	std::ostringstream ss;
+
+	ss << planner << ' ' << neighborhood << ' ' << heuristic_type << ' ' << cost_model;
+	if(planner == "theta_star")
+		ss << ' ' << los_max_cost;
+	if(planner == "multi_resolution")
+		ss << ' ' << resolution_levels << ' ' << corridor_width;
+
+	return ss.str();
+}
+
+void A_star::add_segment(const std::vector<Cell>& cells)
+{
+	std::vector<geometry_msgs::PoseStamped> tmp_poses;
+
+	cells_to_poses(cells, tmp_poses);
+	segments.push_back(tmp_poses);
+	roomba_gpath.poses.insert(roomba_gpath.poses.end(), tmp_poses.begin(), tmp_poses.end());
+}
+
+//探索木を区間ごとに保持しておき、cost_mapの変化時にrepair_pathで再利用する
+bool A_star::search_path_d_star(void)
+{
+	Cell s = {init[0], init[1]};
+	Cell g = {goal[0], goal[1]};
+	std::vector<Cell> cells;
+
+	d_star.push_back(D_star_lite());
+	d_star.back().init(grid, s, g);
+	if(!d_star.back().compute_path() || !d_star.back().get_path(cells)){
+		d_star.pop_back();
+		return false;
+	}
+
+	add_segment(cells);
+
+	return true;
+}
+
+//頂点列は格子のセル列に展開して保持し、間引きはsampling_pathに任せる
+bool A_star::search_path_theta_star(Cell s, Cell g, std::vector<Cell>& cells)
+{
+	Theta_star theta_star;
+	std::vector<Cell> vertices;
+
+	theta_star.set_los_max_cost(los_max_cost);
+	if(!theta_star.search(grid, s, g, vertices))
+		return false;
+
+	expand_path(vertices, cells);
+
+	return true;
+}
+
+//time_budget内に解が出なければ探索状態を残してfalseを返し、次の呼び出しで続きから探索する
+bool A_star::search_path_ara_star(void)
+{
+	Cell s = {init[0], init[1]};
+	Cell g = {goal[0], goal[1]};
+	std::vector<Cell> cells;
+	std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now()
+		+ std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(time_budget));
+
+	if(ara_star.size() == segments.size()){
+		ara_star.push_back(ARA_star());
+		ara_star.back().init(grid, s, g, initial_epsilon);
+	}
+	if(!ara_star.back().improve_path(deadline))
+		return false;
+	if(!ara_star.back().get_path(cells)){
+		ara_star.pop_back();
+		return false;
+	}
+	ROS_INFO("segment %d: epsilon %.2f, %d expansions", (int)segments.size(), ara_star.back().get_epsilon(), ara_star.back().get_expansions());
+
+	add_segment(cells);
+
+	return true;
+}
+
+bool A_star::search_path_multi_resolution(Cell s, Cell g, std::vector<Cell>& cells)
+{
+	//帯の幅を最も粗い格子のセル数に直す
+	int corridor = ceil(corridor_width / (map.info.resolution * (1 << multi_resolution.get_levels())));
+
+	if(!multi_resolution.search(s, g, corridor, cells))
+		return false;
+	ROS_INFO("segment %d: %d expansions", (int)segments.size(), multi_resolution.get_expansions());
+
+	return true;
+}
+
+//経路を出した後、time_budgetずつepsilonを下げて各区間の解を改善する
+void A_star::refine_path(void)
+{
+	if(planner != "ara_star")
+		return;
+
+	std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now()
+		+ std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(time_budget));
+	std::vector<Cell> cells;
+	bool updated = false;
+
+	for(int i = 0; i < ara_star.size() && i < segments.size(); i++){
+		if(ara_star[i].is_completed() && !ara_star[i].decrease_epsilon(epsilon_step))
+			continue;
+		if(!ara_star[i].improve_path(deadline))
+			break;
+		if(ara_star[i].get_path(cells)){
+			cells_to_poses(cells, segments[i]);
+			updated = true;
+			ROS_INFO("segment %d: epsilon %.2f, %d expansions", i, ara_star[i].get_epsilon(), ara_star[i].get_expansions());
+		}
+	}
+
+	if(updated){
+		rebuild_path();
+		pub_path();
+	}
+}
+
+//現在向かっているwaypointまでのコスト場をdwaに渡す。waypointに近づいたら次に切り替える
+void A_star::update_nav_function(const std::vector<waypoint>& waypoints)
+{
+	if(nav_target >= waypoints.size() || !current_pose)
+		return;
+
+	double dx = current_pose->pose.position.x - waypoints[nav_target].x;
+	double dy = current_pose->pose.position.y - waypoints[nav_target].y;
+	if(sqrt(dx*dx + dy*dy) < nav_goal_tolerance && nav_target + 1 < waypoints.size()){
+		nav_target++;
+		nav_dirty = true;
+	}
+	if(!nav_dirty)
+		return;
+
+	double res = map.info.resolution;
+	double origin_x = map.info.origin.position.x;
+	double origin_y = map.info.origin.position.y;
+	Cell g = {(int)floor((waypoints[nav_target].x - origin_x) / res), (int)floor((waypoints[nav_target].y - origin_y) / res)};
+	Cell s = {(int)floor((current_pose->pose.position.x - origin_x) / res), (int)floor((current_pose->pose.position.y - origin_y) / res)};
+
+	nav_function.compute(grid, g, s, nav_margin / res);
+	pub_nav_function();
+	nav_dirty = false;
+}
+
+void A_star::pub_nav_function(void)
+{
+	chibi19_a::NavigationFunction::Ptr msg = boost::make_shared<chibi19_a::NavigationFunction>();
+	double res = map.info.resolution;
+	Cell g = nav_function.get_goal();
+	const std::vector<float>& field = nav_function.get_field();
+
+	msg->header.frame_id = "map";
+	msg->header.stamp = ros::Time::now();
+	msg->info.resolution = res;
+	msg->info.width = nav_function.get_width();
+	msg->info.height = nav_function.get_height();
+	msg->info.origin = map.info.origin;
+	msg->info.origin.position.x += nav_function.get_min_x()*res;
+	msg->info.origin.position.y += nav_function.get_min_y()*res;
+	msg->goal.x = g.x*res + map.info.origin.position.x;
+	msg->goal.y = g.y*res + map.info.origin.position.y;
+	msg->data.resize(field.size());
+	for(int i = 0; i < field.size(); i++){
+		msg->data[i] = field[i]*res;
+	}
+
+	nav_function_pub.publish(msg);
+}
+
+void A_star::cells_to_poses(const std::vector<Cell>& cells, std::vector<geometry_msgs::PoseStamped>& poses)
+{
 	double res = map.info.resolution;
 	double origin_x = map.info.origin.position.x;
 	double origin_y = map.info.origin.position.y;
 	geometry_msgs::PoseStamped gpath_point;
 	gpath_point.header.frame_id = "map";
-	//roomba_gpath.poses.clear();
-
-
-	std::vector<std::vector<char> > delta = {
-		{-1,  0, 0},
-		//{-1, -1},
-		{ 0, -1, 0},
-		//{ 1, -1},
-		{ 1,  0, 0},
-		//{ 1,  1},
-		{ 0,  1, 0}
-		//{-1,  1}
-	};
-
-	std::vector<std::vector<bool> > closed(row, std::vector<bool>(col, false));
-	closed[init[0]][init[1]] = true;
-	std::vector<std::vector<char> > action(row, std::vector<char>(col, -1));
-
-	Open open_init = {f, g, h, x, y};
-	std::vector<Open> open;
-	open.push_back(open_init);
-	Open next = {0, 0, 0, 0, 0};
-	Open new_open = {0, 0, 0, 0, 0};
-
-	while(!found && !resign){
-		if(!open.size()){
-			resign = true;
-			//ROS_INFO("\nfail\n");
-			return false;
+	gpath_point.pose.position.z = 0;
+
+	poses.clear();
+	for(int i = 0; i < cells.size(); i++){
+		int j = std::min(i + 1, (int)cells.size() - 1);
+		double yaw = 0.0;
+		if(j != i)
+			yaw = atan2(cells[j].y - cells[i].y, cells[j].x - cells[i].x);
+		else if(i > 0)
+			yaw = atan2(cells[i].y - cells[i-1].y, cells[i].x - cells[i-1].x);
+
+		gpath_point.pose.position.x = cells[i].x*res + origin_x;
+		gpath_point.pose.position.y = cells[i].y*res + origin_y;
+		quaternionTFToMsg(tf::createQuaternionFromYaw(yaw), gpath_point.pose.orientation);
+		poses.push_back(gpath_point);
+	}
+}
+
+//変化したセルを各区間のD* Liteに通知し、影響を受けた部分だけ再探索する
+void A_star::repair_path(const std::vector<Cell>& changed)
+{
+	ros::WallTime begin = ros::WallTime::now();
+	std::vector<Cell> cells;
+	int expansions = 0;
+
+	for(int i = 0; i < d_star.size(); i++){
+		for(int j = 0; j < changed.size(); j++){
+			d_star[i].update_cell(changed[j].x, changed[j].y);
+		}
+		if(d_star[i].compute_path() && d_star[i].get_path(cells)){
+			cells_to_poses(cells, segments[i]);
 		} else {
-			std::sort(open.begin(), open.end(), [](const Open x, const Open y){
-				return x.f > y.f;
-			});
-			next = open.back();
-			open.pop_back();
-			x = next.x;
-			y = next.y;
-			g = next.g;
-			f = next.f;
-			if(x == goal[0] && y == goal[1]){
-				found = true;
-				//ROS_INFO("found");
-			} else {
-				for(int i = 0; i < delta.size(); i++){
-					x2 = x + delta[i][0];
-					y2 = y + delta[i][1];
-					if(x2 >= 0 && x2 < row && y2 >= 0 && y2 < col){
-						if(!closed[x2][y2] && grid[x2][y2] != 100){
-							g2 = g + cost + grid[x2][y2];
-							h2 = heuristic[x2][y2];
-							f2 = g2 + h2;
-
-							new_open.f = f2;
-							new_open.g = g2;
-							new_open.h = h2;
-							new_open.x = x2;
-							new_open.y = y2;
-							open.push_back(new_open);
-
-							closed[x2][y2] = true;
-							action[x2][y2] = i;
-
-						}
-					}
-				}
-			}
+			ROS_WARN("segment %d: no path after map update", i);
 		}
+		expansions += d_star[i].get_expansions();
 	}
-	//ROS_INFO("search completed");	
-	x = goal[0];
-	y = goal[1];
-	std::vector<geometry_msgs::PoseStamped> tmp_poses;
 
-	gpath_point.pose.position.x = x*res + origin_x;
-	gpath_point.pose.position.y = y*res + origin_y;
-	gpath_point.pose.position.z = 0;
-	quaternionTFToMsg(tf::createQuaternionFromYaw(delta[action[x][y]][2]), gpath_point.pose.orientation);
-
-	tmp_poses.push_back(gpath_point);
-	while(x != init[0] || y != init[1]){
-		x2 = x - delta[action[x][y]][0];
-		y2 = y - delta[action[x][y]][1];
-		gpath_point.pose.position.x = x2*res + origin_x;
-		gpath_point.pose.position.y = y2*res + origin_y;
-		quaternionTFToMsg(tf::createQuaternionFromYaw(delta[action[x][y]][2]), gpath_point.pose.orientation);
-		tmp_poses.push_back(gpath_point);
-	
-		x = x2;
-		y = y2;
-	}
-	std::reverse(tmp_poses.begin(), tmp_poses.end());
-	roomba_gpath.poses.insert(roomba_gpath.poses.end(), tmp_poses.begin(), tmp_poses.end());
+	rebuild_path();
+	if(path_published)
+		pub_path();
+	nav_dirty = true;
 
-	sampling_path();
+	ROS_INFO("replanned %d cells: %d expansions, %.2f ms", (int)changed.size(), expansions, (ros::WallTime::now() - begin).toSec()*1000.0);
+}
 
-	//ROS_INFO("set path");
-	return true;
+void A_star::rebuild_path(void)
+{
+	roomba_gpath.poses.clear();
+	for(int i = 0; i < segments.size(); i++){
+		roomba_gpath.poses.insert(roomba_gpath.poses.end(), segments[i].begin(), segments[i].end());
+	}
+	sampling_path();
 }
 
 void A_star::sampling_path(void)
 {
-	samp_path.poses.clear();
+	if(path_sampling == "shortcut"){
+		shortcut_sampling_path();
+		return;
+	}
+
+	samp_path.reset(new nav_msgs::Path);
+	samp_path->header.frame_id = "map";
 	geometry_msgs::PoseStamped path_end;
 	double dx;
 	double dy;
@@ -306,77 +643,75 @@ void A_star::sampling_path(void)
 	int j = 0;
 	
 	for(int i=0; i < path_size; i += step){
-		samp_path.poses.push_back(roomba_gpath.poses[i]);
+		samp_path->poses.push_back(roomba_gpath.poses[i]);
 		dx = roomba_gpath.poses[i+step].pose.position.x - roomba_gpath.poses[i].pose.position.x;
 		dy = roomba_gpath.poses[i+step].pose.position.y - roomba_gpath.poses[i].pose.position.y;
 		theta = atan2(dy, dx);
-		quaternionTFToMsg(tf::createQuaternionFromYaw(theta), samp_path.poses[j].pose.orientation);
+		quaternionTFToMsg(tf::createQuaternionFromYaw(theta), samp_path->poses[j].pose.orientation);
 
 		j++;
 		if(i+step > path_size){
 			path_end = roomba_gpath.poses.back();
-			samp_path.poses.push_back(path_end);
-			samp_path.poses[j].pose.orientation = samp_path.poses[j-1].pose.orientation;
+			samp_path->poses.push_back(path_end);
+			samp_path->poses[j].pose.orientation = samp_path->poses[j-1].pose.orientation;
 		}
 	}
 }
 
+//視線の通る範囲で経路を直線に置き換え、折れ点(とpose_interval毎の中間点)だけを出す
+void A_star::shortcut_sampling_path(void)
+{
+	double res = map.info.resolution;
+	double origin_x = map.info.origin.position.x;
+	double origin_y = map.info.origin.position.y;
+	std::vector<std::vector<Cell> > cells(segments.size());
+	std::vector<Cell> vertices;
+	geometry_msgs::PoseStamped point;
+	point.header.frame_id = "map";
+	point.pose.position.z = 0;
+
+	samp_path.reset(new nav_msgs::Path);
+	samp_path->header.frame_id = "map";
+	//区間ごとに直線化する(全体を一度に直線化すると、周回の経路はstartに戻るだけになる)
+	for(int s = 0; s < segments.size(); s++){
+		cells[s].reserve(segments[s].size());
+		for(int i = 0; i < segments[s].size(); i++){
+			Cell c = {
+				(int)round((segments[s][i].pose.position.x - origin_x) / res),
+				(int)round((segments[s][i].pose.position.y - origin_y) / res)
+			};
+			cells[s].push_back(c);
+		}
+	}
+	shortcut_segments(grid, cells, vertices, los_max_cost);
+	if(vertices.empty())
+		return;
+
+	double theta = 0.0;
+	for(int i = 1; i < vertices.size(); i++){
+		double dx = (vertices[i].x - vertices[i-1].x)*res;
+		double dy = (vertices[i].y - vertices[i-1].y)*res;
+		int n = 1;
+		if(pose_interval > 0.0)
+			n = std::max(1, (int)ceil(sqrt(dx*dx + dy*dy) / pose_interval));
+		theta = atan2(dy, dx);
+		for(int k = 0; k < n; k++){
+			point.pose.position.x = vertices[i-1].x*res + origin_x + dx*k/n;
+			point.pose.position.y = vertices[i-1].y*res + origin_y + dy*k/n;
+			quaternionTFToMsg(tf::createQuaternionFromYaw(theta), point.pose.orientation);
+			samp_path->poses.push_back(point);
+		}
+	}
+	point.pose.position.x = vertices.back().x*res + origin_x;
+	point.pose.position.y = vertices.back().y*res + origin_y;
+	quaternionTFToMsg(tf::createQuaternionFromYaw(theta), point.pose.orientation);
+	samp_path->poses.push_back(point);
+}
+
 void A_star::pub_path(void)
 {
 	//roomba_gpath_pub.publish(roomba_gpath);
 	roomba_gpath_pub.publish(samp_path);
+	path_published = true;
 	//ROS_INFO("publsh path");
 }
-
-int main(int argc, char **argv)
-{
-	ros::init(argc, argv, "a_star");
-	ros::NodeHandle n;
-	ros::NodeHandle private_nh("~");
-	ros::Rate loop_rate(10);
-
-	const int waycount = 6;
-	std::vector<waypoint> waypoints(waycount);
-
-	private_nh.param("wx1", waypoints[0].x, 0.0);
-	private_nh.param("wy1", waypoints[0].y, 0.0);
-	private_nh.param("wx2", waypoints[1].x, 0.0);
-	private_nh.param("wy2", waypoints[1].y, 0.0);
-	private_nh.param("wx3", waypoints[2].x, 0.0);
-	private_nh.param("wy3", waypoints[2].y, 0.0);
-	private_nh.param("wx4", waypoints[3].x, 0.0);
-	private_nh.param("wy4", waypoints[3].y, 0.0);
-	private_nh.param("wx5", waypoints[4].x, 0.0);
-	private_nh.param("wy5", waypoints[4].y, 0.0);
-	private_nh.param("wx6", waypoints[5].x, 0.0);
-	private_nh.param("wy6", waypoints[5].y, 0.0);
-	//private_nh.param("wx7", waypoints[6].x, 0.0);
-	//private_nh.param("wy7", waypoints[6].y, 0.0);
-	//private_nh.param("wx8", waypoints[7].x, 0.0);
-	//private_nh.param("wy8", waypoints[7].y, 0.0);
-
-
-	A_star as;
-	int count = 0;
-	
-	while(ros::ok())
-	{
-		if(initflag && !setWP){
-			as.set_waypoint(waycount, waypoints);
-			setWP = true;
-		}
-		if(map_received && setWP && count < waycount+1){
-			if(as.search_path(waypoints[count].x, waypoints[count].y, waypoints[count+1].x, waypoints[count+1].y)){
-					//as.pub_path();
-					count++;
-			}
-		}
-		if(count == waycount +1){
-			as.pub_path();
-		}
-		ros::spinOnce();
-		loop_rate.sleep();
-  	}
-
-  return 0;
-}
@@ -0,0 +1,16 @@
+#include "chibi19_a/a_star_node.h"
+
+int main(int argc, char **argv)
+{
+	ros::init(argc, argv, "a_star");
+	ros::NodeHandle n;
+	ros::NodeHandle private_nh("~");
+
+	A_star as(n, private_nh);
+	if(!as.get_waypoint_count())
+		return 1;
+
+	ros::spin();
+
+	return 0;
+}
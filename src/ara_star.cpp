@@ -0,0 +1,204 @@
+#include "chibi19_a/ara_star.h"
+#include <cmath>
+#include <limits>
+#include <algorithm>
+
+namespace
+{
+const double INF = std::numeric_limits<double>::infinity();
+//時間切れの確認間隔(展開数)
+const int CHECK_INTERVAL = 256;
+}
+
+bool ARA_star::EntryCompare::operator()(const Entry& a, const Entry& b) const
+{
+	return a.f > b.f || (a.f == b.f && a.g < b.g);
+}
+
+ARA_star::ARA_star(void)
+{
+	grid = NULL;
+	row = 0;
+	col = 0;
+	start.x = start.y = 0;
+	goal.x = goal.y = 0;
+	epsilon = 1.0;
+	completed = false;
+	expansions = 0;
+}
+
+void ARA_star::init(const std::vector<std::vector<char> >& map_grid, Cell s, Cell g, double eps)
+{
+	grid = &map_grid;
+	row = map_grid.size();
+	col = row ? map_grid[0].size() : 0;
+	start = s;
+	goal = g;
+	epsilon = std::max(eps, 1.0);
+	completed = false;
+	expansions = 0;
+
+	nodes.clear();
+	open = std::priority_queue<Entry, std::vector<Entry>, EntryCompare>();
+
+	Node n = {0.0, start.x*col + start.y, false, false, false};
+	nodes[start.x*col + start.y] = n;
+	push(start.x*col + start.y);
+}
+
+double ARA_star::cell_cost(int x, int y) const
+{
+	char c = (*grid)[x][y];
+	if(!is_passable(c))
+		return INF;
+	return enter_cost(c);
+}
+
+double ARA_star::fvalue(int id, double g) const
+{
+	int x = id / col;
+	int y = id % col;
+	return g + epsilon*(std::abs(goal.x - x) + std::abs(goal.y - y));
+}
+
+void ARA_star::push(int id)
+{
+	Node& n = nodes[id];
+	n.in_open = true;
+	Entry e = {fvalue(id, n.g), n.g, id};
+	open.push(e);
+}
+
+//現在のepsilonでのImprovePath。deadlineを過ぎたら途中でもfalseを返し、次の呼び出しで続きから探索する
+bool ARA_star::improve_path(std::chrono::steady_clock::time_point deadline)
+{
+	int g_id = goal.x*col + goal.y;
+	int count = 0;
+
+	if(completed)
+		return true;
+
+	while(!open.empty()){
+		Entry top = open.top();
+		std::unordered_map<int, Node>::iterator it = nodes.find(top.id);
+		if(!it->second.in_open || it->second.g != top.g){
+			open.pop();
+			continue;
+		}
+
+		std::unordered_map<int, Node>::const_iterator goal_it = nodes.find(g_id);
+		if(goal_it != nodes.end() && goal_it->second.g <= top.f)
+			break;
+
+		if(++count % CHECK_INTERVAL == 0 && std::chrono::steady_clock::now() > deadline)
+			return false;
+
+		open.pop();
+		Node& u = it->second;
+		u.in_open = false;
+		u.closed = true;
+		expansions++;
+
+		int x = top.id / col;
+		int y = top.id % col;
+		for(int i = 0; i < 4; i++){
+			int x2 = x + GRID_DELTA[i][0];
+			int y2 = y + GRID_DELTA[i][1];
+			if(x2 < 0 || x2 >= row || y2 < 0 || y2 >= col)
+				continue;
+			double c = cell_cost(x2, y2);
+			if(c == INF)
+				continue;
+
+			int id2 = x2*col + y2;
+			std::unordered_map<int, Node>::iterator it2 = nodes.find(id2);
+			if(it2 == nodes.end()){
+				Node n = {INF, id2, false, false, false};
+				it2 = nodes.insert(std::make_pair(id2, n)).first;
+			}
+			Node& v = it2->second;
+			if(v.g > u.g + c){
+				v.g = u.g + c;
+				v.parent = top.id;
+				if(!v.closed){
+					push(id2);
+				} else {
+					v.incons = true;
+				}
+			}
+		}
+	}
+
+	completed = true;
+	return true;
+}
+
+//OPENにINCONSを戻し、新しいepsilonで優先度を付け直す
+bool ARA_star::decrease_epsilon(double dec)
+{
+	if(epsilon <= 1.0)
+		return false;
+
+	epsilon = std::max(1.0, epsilon - dec);
+	completed = false;
+
+	open = std::priority_queue<Entry, std::vector<Entry>, EntryCompare>();
+	for(std::unordered_map<int, Node>::iterator it = nodes.begin(); it != nodes.end(); ++it){
+		Node& n = it->second;
+		n.closed = false;
+		if(n.incons){
+			n.incons = false;
+			n.in_open = true;
+		}
+		if(n.in_open){
+			Entry e = {fvalue(it->first, n.g), n.g, it->first};
+			open.push(e);
+		}
+	}
+
+	return true;
+}
+
+bool ARA_star::get_path(std::vector<Cell>& path) const
+{
+	int s_id = start.x*col + start.y;
+	int id = goal.x*col + goal.y;
+
+	path.clear();
+	if(!has_path())
+		return false;
+
+	while(true){
+		Cell c = {id / col, id % col};
+		path.push_back(c);
+		if(id == s_id)
+			break;
+		if(path.size() > nodes.size())
+			return false;
+		id = nodes.find(id)->second.parent;
+	}
+	std::reverse(path.begin(), path.end());
+
+	return true;
+}
+
+bool ARA_star::has_path(void) const
+{
+	std::unordered_map<int, Node>::const_iterator it = nodes.find(goal.x*col + goal.y);
+	return it != nodes.end() && it->second.g < INF;
+}
+
+bool ARA_star::is_completed(void) const
+{
+	return completed;
+}
+
+double ARA_star::get_epsilon(void) const
+{
+	return epsilon;
+}
+
+int ARA_star::get_expansions(void) const
+{
+	return expansions;
+}
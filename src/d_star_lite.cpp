@@ -0,0 +1,240 @@
+#include "chibi19_a/d_star_lite.h"
+#include <cmath>
+#include <limits>
+#include <algorithm>
+
+namespace
+{
+const double INF = std::numeric_limits<double>::infinity();
+
+bool key_less(double a1, double a2, double b1, double b2)
+{
+	return a1 < b1 || (a1 == b1 && a2 < b2);
+}
+}
+
+bool D_star_lite::EntryCompare::operator()(const Entry& a, const Entry& b) const
+{
+	return key_less(b.key.k1, b.key.k2, a.key.k1, a.key.k2);
+}
+
+D_star_lite::D_star_lite(void)
+{
+	grid = NULL;
+	row = 0;
+	col = 0;
+	start.x = start.y = 0;
+	goal.x = goal.y = 0;
+	expansions = 0;
+}
+
+void D_star_lite::init(const std::vector<std::vector<char> >& map_grid, Cell s, Cell g)
+{
+	grid = &map_grid;
+	row = map_grid.size();
+	col = row ? map_grid[0].size() : 0;
+	start = s;
+	goal = g;
+	expansions = 0;
+
+	nodes.clear();
+	open = std::priority_queue<Entry, std::vector<Entry>, EntryCompare>();
+
+	Node goal_node = {INF, 0.0, {0.0, 0.0}, false};
+	nodes[to_id(goal.x, goal.y)] = goal_node;
+	push(to_id(goal.x, goal.y));
+}
+
+int D_star_lite::to_id(int x, int y) const
+{
+	return x*col + y;
+}
+
+bool D_star_lite::is_valid(int x, int y) const
+{
+	return x >= 0 && x < row && y >= 0 && y < col;
+}
+
+double D_star_lite::cell_cost(int x, int y) const
+{
+	char c = (*grid)[x][y];
+	if(!is_passable(c))
+		return INF;
+	return enter_cost(c);
+}
+
+//逆向き探索なのでstartまでのマンハッタン距離
+double D_star_lite::heuristic(int x, int y) const
+{
+	return std::abs(start.x - x) + std::abs(start.y - y);
+}
+
+double D_star_lite::get_g(int id) const
+{
+	std::unordered_map<int, Node>::const_iterator it = nodes.find(id);
+	return it == nodes.end() ? INF : it->second.g;
+}
+
+double D_star_lite::get_rhs(int id) const
+{
+	std::unordered_map<int, Node>::const_iterator it = nodes.find(id);
+	return it == nodes.end() ? INF : it->second.rhs;
+}
+
+D_star_lite::Key D_star_lite::calc_key(int id) const
+{
+	double m = std::min(get_g(id), get_rhs(id));
+	Key key = {m + heuristic(id / col, id % col), m};
+	return key;
+}
+
+void D_star_lite::push(int id)
+{
+	Node& n = nodes[id];
+	n.key = calc_key(id);
+	n.in_open = true;
+	Entry e = {n.key, id};
+	open.push(e);
+}
+
+void D_star_lite::update_vertex(int x, int y)
+{
+	int id = to_id(x, y);
+	std::unordered_map<int, Node>::iterator it = nodes.find(id);
+
+	if(x != goal.x || y != goal.y){
+		double rhs = INF;
+		if(cell_cost(x, y) < INF){
+			for(int i = 0; i < 4; i++){
+				int x2 = x + GRID_DELTA[i][0];
+				int y2 = y + GRID_DELTA[i][1];
+				if(!is_valid(x2, y2))
+					continue;
+				double c = cell_cost(x2, y2);
+				if(c < INF)
+					rhs = std::min(rhs, c + get_g(to_id(x2, y2)));
+			}
+		}
+		//未探索かつ到達不能なセルはノードを作らない
+		if(it == nodes.end()){
+			if(rhs == INF)
+				return;
+			Node n = {INF, rhs, {0.0, 0.0}, false};
+			it = nodes.insert(std::make_pair(id, n)).first;
+		} else {
+			it->second.rhs = rhs;
+		}
+	}
+	if(it == nodes.end())
+		return;
+
+	//open listからは遅延削除(in_openとkeyが一致しないエントリは読み捨てる)
+	it->second.in_open = false;
+	if(it->second.g != it->second.rhs)
+		push(id);
+}
+
+bool D_star_lite::compute_path(void)
+{
+	int s = to_id(start.x, start.y);
+	expansions = 0;
+
+	while(!open.empty()){
+		Entry top = open.top();
+		std::unordered_map<int, Node>::iterator it = nodes.find(top.id);
+		if(it == nodes.end() || !it->second.in_open
+				|| it->second.key.k1 != top.key.k1 || it->second.key.k2 != top.key.k2){
+			open.pop();
+			continue;
+		}
+
+		Key k_start = calc_key(s);
+		if(!key_less(top.key.k1, top.key.k2, k_start.k1, k_start.k2) && get_rhs(s) == get_g(s))
+			break;
+
+		open.pop();
+		Node& u = it->second;
+		u.in_open = false;
+
+		Key k_new = calc_key(top.id);
+		if(key_less(top.key.k1, top.key.k2, k_new.k1, k_new.k2)){
+			push(top.id);
+			continue;
+		}
+
+		expansions++;
+		int x = top.id / col;
+		int y = top.id % col;
+		if(u.g > u.rhs){
+			u.g = u.rhs;
+		} else {
+			u.g = INF;
+			update_vertex(x, y);
+		}
+		for(int i = 0; i < 4; i++){
+			int x2 = x + GRID_DELTA[i][0];
+			int y2 = y + GRID_DELTA[i][1];
+			if(is_valid(x2, y2))
+				update_vertex(x2, y2);
+		}
+	}
+
+	return get_rhs(s) < INF;
+}
+
+//セル(x, y)のコストが変わったとき、そのセルに入る辺を持つ近傍を更新する
+void D_star_lite::update_cell(int x, int y)
+{
+	if(!is_valid(x, y))
+		return;
+
+	update_vertex(x, y);
+	for(int i = 0; i < 4; i++){
+		int x2 = x + GRID_DELTA[i][0];
+		int y2 = y + GRID_DELTA[i][1];
+		if(is_valid(x2, y2))
+			update_vertex(x2, y2);
+	}
+}
+
+bool D_star_lite::get_path(std::vector<Cell>& path) const
+{
+	path.clear();
+	if(get_g(to_id(start.x, start.y)) == INF)
+		return false;
+
+	Cell cur = start;
+	size_t max_steps = nodes.size() + 1;
+	path.push_back(cur);
+	while(cur.x != goal.x || cur.y != goal.y){
+		if(path.size() > max_steps)
+			return false;
+
+		double min_cost = INF;
+		Cell next = cur;
+		for(int i = 0; i < 4; i++){
+			int x2 = cur.x + GRID_DELTA[i][0];
+			int y2 = cur.y + GRID_DELTA[i][1];
+			if(!is_valid(x2, y2))
+				continue;
+			double c = cell_cost(x2, y2) + get_g(to_id(x2, y2));
+			if(c < min_cost){
+				min_cost = c;
+				next.x = x2;
+				next.y = y2;
+			}
+		}
+		if(min_cost == INF)
+			return false;
+
+		cur = next;
+		path.push_back(cur);
+	}
+
+	return true;
+}
+
+int D_star_lite::get_expansions(void) const
+{
+	return expansions;
+}
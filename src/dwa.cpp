@@ -1,124 +1,12 @@
-#include "ros/ros.h"
-#include "std_msgs/Bool.h"
-#include "std_msgs/String.h"
-#include "nav_msgs/Path.h"
-#include "nav_msgs/Odometry.h"
-#include "sensor_msgs/LaserScan.h"
+#include "chibi19_a/dwa_node.h"
 #include "tf/transform_datatypes.h"
 #include "roomba_500driver_meiji/RoombaCtrl.h"
+#include <boost/make_shared.hpp>
 #include <cmath>
 #include <vector>
-#include <limits>
-#include <chrono>
-#include <sstream>
-
-nav_msgs::Path lpath;
-nav_msgs::Path roomba_gpath;
-nav_msgs::Odometry roomba_odom;
-sensor_msgs::LaserScan roomba_scan;
-geometry_msgs::PoseStamped gpath_goal;
-geometry_msgs::PoseStamped roomba_status;
-
-const double EPS = 1e-6;
-bool can_goal = false;
-bool get_odom = false;
-bool get_pose = false;
-bool line_detection;
-double dt;
-double dv;
-double dyaw;
-double stop_time;
-double max_speed;
-double min_speed;
-double max_accel;
-double ignore_line;
-double limit_speed;
-double max_yawrate;
-double max_dyawrate;
-double limit_yawrate;
-double predict_time;
-double roomba_radius;
-double l_ob_cost_gain;
-double speed_cost_gain;
-double to_g_goal_cost_gain;
-
-struct Speed{
-    double v;
-    double omega;
-};
-
-struct Position{
-    double x;
-    double y;
-    double yaw;
-};
-
-struct Status{
-    double x;
-    double y;
-    double yaw;
-    double v;
-    double omega;
-};
-
-struct Dw{
-    double min_v;
-    double max_v;
-    double min_omega;
-    double max_omega;
-};
-
-void calc_dynamic_window(Dw& dw, const Status roomba)
-{
-    const Dw Vs= {
-        min_speed,
-        limit_speed,
-        -limit_yawrate,
-        limit_yawrate
-    };
-    Dw Vd = {
-        roomba.v - max_accel*dt,
-        roomba.v + max_accel*dt,
-        roomba.omega - max_dyawrate*dt,
-        roomba.omega + max_dyawrate*dt
-    };
-    dw.min_v = std::max(Vs.min_v, Vd.min_v);
-    dw.max_v = std::min(Vs.max_v, Vd.max_v);
-    dw.min_omega = std::max(Vs.min_omega, Vd.min_omega);
-    dw.max_omega = std::min(Vs.max_omega, Vd.max_omega);
-    return;
-}
-
-void angle_range(double& theta)
-{
-    if(theta > M_PI){
-        theta -= 2*M_PI;
-    } else if(theta < -M_PI){
-        theta += 2*M_PI;
-    }
-    return;
-}
 
-double atan(const double x, const double y)
+namespace
 {
-    double theta = 0.0;
-
-    if(std::fabs(x) <= EPS){
-        if(std::fabs(y) <= EPS){
-            theta = 0.0;
-        } else if(y < -EPS) {
-            theta = -M_PI/2;
-        } else if(y > EPS) {
-            theta = M_PI/2;
-        }
-    } else {
-        theta = std::atan2(y, x);
-        angle_range(theta);
-    }
-
-    return theta;
-}
-
 //二点間の距離を計算
 double calc_dist(const double x1, const double x2, const double y1, const double y2){
     double dx = x1 - x2;
@@ -130,40 +18,128 @@ double calc_dist(const double x1, const double x2, const double y1, const double
     return dist;
 }
 
-//全部local
-void motion(Status& roomba, const double v, const double y)
+bool is_normalized(const geometry_msgs::Quaternion& msg)
 {
-    roomba.yaw += y*dt;
-    angle_range(roomba.yaw);
-    roomba.x += v*std::cos(roomba.yaw)*dt;
-    roomba.y += v*std::sin(roomba.yaw)*dt;
-    roomba.v = v;
-    roomba.omega = y;
-    return;
+    const double quaternion_tolerance = 0.10;
+    tf::Quaternion bt = tf::Quaternion(msg.x, msg.y, msg.z, msg.w);
+
+    if(fabs(bt.length2() - 1.0) > quaternion_tolerance){
+        std::cout << "Quaternion unnormalized" << std::endl;
+        return false;
+    } else {
+        return true;
+    }
 }
 
-//全部local
-void calc_l_traj(std::vector<Status>& traj, const double v, const double y)
+//経路の中身(各点の位置と向き)が同じか
+bool same_path(const nav_msgs::Path& a, const nav_msgs::Path& b)
 {
-    Status roomba = {0.0, 0.0, 0.0, 0.0, 0.0};
-    int elements_t = 0;
-
-    traj.clear();
-    elements_t = int(predict_time/dt);
-    for(int t_i = 0; t_i < elements_t; t_i++){
-        traj.push_back(roomba);
-        motion(roomba, v, y);
+    if(a.poses.size() != b.poses.size()) return false;
+    for(int i = 0; i < a.poses.size(); i++){
+        const geometry_msgs::Pose& p = a.poses[i].pose;
+        const geometry_msgs::Pose& q = b.poses[i].pose;
+        if(p.position.x != q.position.x || p.position.y != q.position.y) return false;
+        if(p.orientation.z != q.orientation.z || p.orientation.w != q.orientation.w) return false;
     }
-    traj.push_back(roomba);
-    return;
+    return true;
+}
 }
 
-void log_best_traj(const std::vector<Status>& l_traj){
+Dwa::Dwa(ros::NodeHandle n, ros::NodeHandle private_nh) : nh(n)
+{
+    roomba_cntl_pub = nh.advertise<roomba_500driver_meiji::RoombaCtrl>("roomba/control", 1);
+    lpath_pub = nh.advertise<nav_msgs::Path>("lpath", 1);
+    gpath_goal_pub = nh.advertise<geometry_msgs::PoseStamped>("gpath_goal", 1);
+
+    //scanが来るたびに制御する、scan_timeout[s]来なければ止まる
+    private_nh.param("scan_timeout", scan_timeout, 0.5);
+
+    Local_planner_params params;
+    private_nh.param("dt", params.dt, 0.0);
+    private_nh.param("dv", params.dv, 0.0);
+    private_nh.param("dyaw", params.dyaw, 0.0);
+    private_nh.param("stop_time", stop_time, 0.0);
+    private_nh.param("max_speed", max_speed, 0.0);
+    private_nh.param("min_speed", params.min_speed, 0.0);
+    private_nh.param("max_accel", params.max_accel, 0.0);
+    private_nh.param("ignore_line", ignore_line, 0.0);
+    private_nh.param("limit_speed", params.limit_speed, 0.0);
+    private_nh.param("max_yawrate", max_yawrate, 0.0);
+    private_nh.param("predict_time", params.predict_time, 0.0);
+    private_nh.param("max_dyawrate", params.max_dyawrate, 0.0);
+    private_nh.param("limit_yawrate", params.limit_yawrate, 0.0);
+    private_nh.param("roomba_radius", roomba_radius, 0.0);
+    params.roomba_radius = roomba_radius;
+    private_nh.param("l_ob_cost_gain", params.l_ob_cost_gain, 0.0);
+    private_nh.param("to_g_goal_cost_gain", params.to_g_goal_cost_gain, 0.0);
+    private_nh.param("path_cost_gain", params.path_cost_gain, 0.0);
+    private_nh.param("heading_cost_gain", params.heading_cost_gain, 0.0);
+    private_nh.param("speed_cost_gain", params.speed_cost_gain, 0.0);
+    private_nh.param("smoothness_cost_gain", params.smoothness_cost_gain, 0.0);
+    private_nh.param("print_cost_breakdown", params.print_cost_breakdown, false);
+    private_nh.param("use_nav_function", params.use_nav_function, false);
+    private_nh.param("nav_cost_gain", params.nav_cost_gain, 0.0);
+    private_nh.param("ob_grid_resolution", params.ob_grid_resolution, 0.02);
+    private_nh.param("ob_dist_max", params.ob_dist_max, 1.0);
+    //scanの前処理(使わない角度の範囲[min, max, ...]、間引き)
+    private_nh.getParam("scan_mask", params.scan_filter.mask);
+    private_nh.param("scan_beam_step", params.scan_filter.beam_step, 1);
+    private_nh.param("scan_max_beams", params.scan_filter.max_beams, 0);
+
+    //library: 起動時に計算した軌道を引く, batch: 候補をまとめてその場で積分する
+    private_nh.param("rollout_mode", params.rollout_mode, std::string("library"));
+    //grid: 距離場を軌道の各点で引く, arc: 円弧とscan点の距離を解析的に求める
+    private_nh.param("clearance_mode", params.clearance_mode, std::string("grid"));
+    //lattice: 格子点を全部評価する, adaptive: 粗い格子から細かくしていき、time_budget[s]で打ち切る
+    private_nh.param("sampling_mode", params.sampling_mode, std::string("lattice"));
+    private_nh.param("time_budget", params.time_budget, 0.02);
+    //dwa: (v, omega)一定の軌道から選ぶ, mppi: 時間とともに変わる制御列を最適化する
+    private_nh.param("controller", params.controller, std::string("dwa"));
+    private_nh.param("mppi_samples", params.mppi_samples, 256);
+    private_nh.param("mppi_lambda", params.mppi_lambda, 0.005);
+    private_nh.param("mppi_sigma_v", params.mppi_sigma_v, 0.05);
+    private_nh.param("mppi_sigma_omega", params.mppi_sigma_omega, 0.3);
+    private_nh.param("num_threads", params.num_threads, 1);
+    planner.init(params);
+    ROS_INFO("trajectory library: %d x %d rollouts", planner.get_traj_library().v_size, planner.get_traj_library().omega_size);
+
+    std::string replay_file;
+    private_nh.param("replay_file", replay_file, std::string(""));
+    if(!replay_file.empty()){
+        replay.open(replay_file.c_str());
+        if(!replay) ROS_WARN("cannot open %s", replay_file.c_str());
+    }
+
+    monitor.init(nh, private_nh, "dwa");
+
+    lpath = boost::make_shared<nav_msgs::Path>();
+    lpath->header.frame_id = "base_link";
+    gpath_goal = boost::make_shared<geometry_msgs::PoseStamped>();
+    gpath_goal->header.frame_id = "map";
+    line_detection = false;
+    state = WAITING;
+    reached_goal.x = reached_goal.y = reached_goal.yaw = 0.0;
+    detected_line.x = detected_line.y = detected_line.yaw = 0.0;
+    invalid_l_d = false;
+    timed_out = false;
+    last_scan = ros::Time::now();
+
+    roomba_odom_sub = nh.subscribe("roomba/odometry", 1, &Dwa::odom_callback, this);
+    roomba_scan_sub = nh.subscribe("scan", 1, &Dwa::scan_callback, this);
+    roomba_gpath_sub = nh.subscribe("gpath", 1, &Dwa::gpath_callback, this);
+    roomba_status_sub = nh.subscribe("amcl_pose", 1, &Dwa::amcl_callback, this);
+    line_detection_sub = nh.subscribe("detection", 1, &Dwa::line_detection_callback, this);
+    nav_function_sub = nh.subscribe("nav_function", 1, &Dwa::nav_function_callback, this);
+    //scanが途切れていないかは別のタイマで見る
+    watchdog = nh.createTimer(ros::Duration(0.05), &Dwa::watchdog_callback, this);
+}
+
+void Dwa::log_best_traj(const std::vector<Status>& l_traj){
     geometry_msgs::PoseStamped lpath_point;
     lpath_point.pose.position.z = 0.0;
 
-    lpath.poses.clear();
-    lpath.header.frame_id = "base_link";
+    lpath = boost::make_shared<nav_msgs::Path>();
+    lpath->header.frame_id = "base_link";
 
     for(int i = 0; i < l_traj.size(); i++){
         lpath_point.header.frame_id = "base_link";
@@ -171,175 +147,30 @@ void log_best_traj(const std::vector<Status>& l_traj){
         lpath_point.pose.position.y = l_traj[i].y;
         lpath_point.pose.orientation = tf::createQuaternionMsgFromYaw(l_traj[i].yaw);
 
-        lpath.poses.push_back(lpath_point);
+        lpath->poses.push_back(lpath_point);
     }
     return;
 }
 
-double calc_to_g_goal_cost(const std::vector<Status> l_traj, const Status g_roomba, const Position g_goal)
-{
-    Status l_last = l_traj.back();
-    Position g_last = {0.0, 0.0, 0.0};
-    double to_g_goal_dis = 0.0;
-    double s = std::sin(g_roomba.yaw);
-    double c = std::cos(g_roomba.yaw);
-
-    g_last.x = g_roomba.x + l_last.x*c - l_last.y*s;
-    g_last.y = g_roomba.y + l_last.x*s + l_last.y*c;
-
-    to_g_goal_dis = calc_dist(g_goal.x, g_last.x, g_goal.y, g_last.y);
-
-    return to_g_goal_cost_gain*to_g_goal_dis;
-}
-
-double calc_to_g_path_cost(const std::vector<Status> l_traj, const Status g_roomba, const nav_msgs::Path g_path)
-{
-    Position g_goal = {0.0, 0.0, 0.0};
-    Position g_path_point = {0.0, 0.0, 0.0};
-    int n_g_path_p_d_i = 0;//nearest gpath point distance i
-    int next_g_path_p_i = 0;
-    double n_g_path_p_d = 10000.0;//nearest gpath point distance
-    double g_error_dist = 0.0;
-    double to_g_path_cost = 0.0;
-
-    if(!can_goal){
-        //スタートでg_path.poses[0]が最も近い点となるように-10している
-        for(int i = 0; i < g_path.poses.size() - 10; i++){
-            g_path_point.x = g_path.poses[i].pose.position.x;
-            g_path_point.y = g_path.poses[i].pose.position.y;
-            g_error_dist = calc_dist(g_path_point.x, g_roomba.x, g_path_point.y, g_roomba.y);
-
-            if(n_g_path_p_d > g_error_dist){
-                n_g_path_p_d = g_error_dist;
-                n_g_path_p_d_i = i;
-            }
-        }
-        next_g_path_p_i = n_g_path_p_d_i + 2;
-        if(next_g_path_p_i >= g_path.poses.size() - 10){
-            can_goal = true;
-            next_g_path_p_i = g_path.poses.size() - 1;
-        }
-    } else {
-        next_g_path_p_i = g_path.poses.size() - 1;
-    }
-
-    g_goal.x = g_path.poses[next_g_path_p_i].pose.position.x;
-    g_goal.y = g_path.poses[next_g_path_p_i].pose.position.y;
-    g_goal.yaw = tf::getYaw(g_path.poses[next_g_path_p_i].pose.orientation);
-
-    //publish用
-    gpath_goal.header.frame_id = "map";
-    gpath_goal.pose.position.x = g_goal.x;
-    gpath_goal.pose.position.y = g_goal.y;
-    gpath_goal.pose.position.z = 0.0;
-    gpath_goal.pose.orientation = tf::createQuaternionMsgFromYaw(g_goal.yaw);
-
-    to_g_path_cost = calc_to_g_goal_cost(l_traj, g_roomba, g_goal);
-
-    return to_g_path_cost;
-}
-
-//全部local
-double calc_l_ob_cost(const std::vector<Status> traj, const std::vector<float> obstacle)
-{
-    const int skip_i = 3;
-    const int skip_j = 20;
-    const double inf = std::numeric_limits<double>::infinity();
-    const double left_rod_max = 1.30;
-    const double left_rod_min = 0.80;
-    const double right_rod_max = -0.80;
-    const double right_rod_min = -1.30;
-    double x = 0.0;
-    double y = 0.0;
-    double ob_dist = 0.0;
-    double ob_theta = 0.0;
-    double dist = 0.0;
-    double min_dist = inf;
-    double final_dist = inf;
-    Position ob = {0.0, 0.0, 0.0};
-
-    for(int i = 0; i < traj.size(); i += skip_i){
-        x = traj[i].x;
-        y = traj[i].y;
-
-        for(int j = 0; j < obstacle.size(); j += skip_j){
-            ob_theta = roomba_scan.angle_min + j*roomba_scan.angle_increment;
-
-            if(( left_rod_min < ob_theta && ob_theta < left_rod_max)
-                    || ( right_rod_min < ob_theta && ob_theta < right_rod_max)) {
-                continue;
-            }
-
-            if(obstacle[j] < 60.0f) ob_dist = obstacle[j];
-            else ob_dist = 60.0;
-
-            ob.x = ob_dist*std::cos(ob_theta);
-            ob.y = ob_dist*std::sin(ob_theta);
-            dist = calc_dist(ob.x, x, ob.y, y);
-
-            if(dist <= roomba_radius) return inf;
-
-            if(min_dist > dist) min_dist = dist;
-        }
-    }
-
-    return l_ob_cost_gain/min_dist;
-}
-
-Speed dwa_control(const Status g_roomba, const std::vector<float> l_ob, const nav_msgs::Path g_path)
-{
-    Dw dw = {0.0, 0.0, 0.0, 0.0};
-    Speed best_output = {0.0, 0.0};
-    std::vector<Status> l_traj;
-    double v = 0.0;
-    double y = 0.0;
-    double min_cost = 1000.0;
-    double l_ob_cost = 0.0;
-    double final_cost = 0.0;
-    double to_g_path_cost = 0.0;
-    int elements_v = 0;
-    int elements_omega = 0;
-
-    //dynamic windowの計算
-    calc_dynamic_window(dw, g_roomba);
-
-    elements_v = int((dw.max_v - dw.min_v)/dv);
-    elements_omega = int((dw.max_omega - dw.min_omega)/dyaw);
-
-    for(int v_i = 0; v_i <= elements_v; v_i++){
-        v = dw.min_v + v_i*dv;
-        for(int y_i = 0; y_i <= elements_omega; y_i++){
-            y = dw.min_omega + y_i*dyaw;
-            if(fabs(y) <= EPS) y = 0.0;
-
-            //軌道計算
-            calc_l_traj(l_traj, v, y);
-
-            //cost計算
-            l_ob_cost = calc_l_ob_cost(l_traj, l_ob);
-            to_g_path_cost = calc_to_g_path_cost(l_traj, g_roomba, g_path);
-
-            final_cost = to_g_path_cost + l_ob_cost;
-
-            if(min_cost > final_cost) {
-                best_output.v = v;
-                best_output.omega = y;
-                log_best_traj(l_traj);
-            }
-        }
-    }
-
-    return best_output;
+//publish用
+void Dwa::log_gpath_goal(const Position& g_goal){
+    gpath_goal = boost::make_shared<geometry_msgs::PoseStamped>();
+    gpath_goal->header.frame_id = "map";
+    gpath_goal->pose.position.x = g_goal.x;
+    gpath_goal->pose.position.y = g_goal.y;
+    gpath_goal->pose.position.z = 0.0;
+    gpath_goal->pose.orientation = tf::createQuaternionMsgFromYaw(g_goal.yaw);
+    return;
 }
 
-//全部global//ゴール判別
-int is_goal(const Status roomba, const Position goal)
+//ゴール判別
+int Dwa::is_goal(const Status& roomba, const Position& goal) const
 {
     double error_dist = 0.0;
 
     error_dist = calc_dist(goal.x, roomba.x, goal.y, roomba.y);
 
-    if(can_goal && error_dist < roomba_radius){
+    if(planner.get_can_goal() && error_dist < roomba_radius){
         std::cout << "Goal" << std::endl;
         return 0;
     } else {
@@ -347,146 +178,168 @@ int is_goal(const Status roomba, const Position goal)
     }
 }
 
-bool is_normalized(const geometry_msgs::Quaternion& msg)
+void Dwa::publish_cntl(int mode, double v, double omega)
 {
-    const double quaternion_tolerance = 0.10;
-    tf::Quaternion bt = tf::Quaternion(msg.x, msg.y, msg.z, msg.w);
+    roomba_500driver_meiji::RoombaCtrl::Ptr roomba_cntl = boost::make_shared<roomba_500driver_meiji::RoombaCtrl>();
 
-    if(fabs(bt.length2() - 1.0) > quaternion_tolerance){
-        std::cout << "Quaternion unnormalized" << std::endl;
-        return false;
-    } else {
-        return true;
+    roomba_cntl->mode = mode;
+    roomba_cntl->cntl.linear.x = v;
+    roomba_cntl->cntl.angular.z = omega;
+    roomba_cntl_pub.publish(roomba_cntl);
+}
+
+//scanが途切れたら障害物が分からないので止まる
+void Dwa::watchdog_callback(const ros::TimerEvent&)
+{
+    if(!timed_out && (ros::Time::now() - last_scan).toSec() > scan_timeout){
+        ROS_WARN("no scan for %.2f s, stop", scan_timeout);
+        publish_cntl(11, 0.0, 0.0);
+        timed_out = true;
     }
 }
 
-void odom_callback(const nav_msgs::Odometry::ConstPtr& msg)
+void Dwa::odom_callback(const nav_msgs::Odometry::ConstPtr& msg)
 {
-    roomba_odom = *msg;
-    get_odom = true;
+    roomba_odom = msg;
 }
 
-void scan_callback(const sensor_msgs::LaserScan::ConstPtr& msg)
+void Dwa::scan_callback(const sensor_msgs::LaserScan::ConstPtr& msg)
 {
-    roomba_scan = *msg;
+    roomba_scan.angle_min = msg->angle_min;
+    roomba_scan.angle_increment = msg->angle_increment;
+    roomba_scan.range_min = msg->range_min;
+    roomba_scan.range_max = msg->range_max;
+    roomba_scan.ranges = msg->ranges;
+    scan_stamp = msg->header.stamp;
+    monitor.record("scan_receive", scan_stamp, ros::Time::now());
+    timed_out = false;
+    last_scan = ros::Time::now();
+    control();
+}
+
+void Dwa::gpath_callback(const nav_msgs::Path::ConstPtr& msg)
+{
+    //同じ経路が再配信されただけなら追従位置を戻さない
+    if(msg == roomba_gpath) return;
+    if(roomba_gpath && same_path(*roomba_gpath, *msg)){
+        roomba_gpath = msg;
+        return;
+    }
+
+    std::vector<Position> path(msg->poses.size());
+
+    roomba_gpath = msg;
+    for(int i = 0; i < path.size(); i++){
+        path[i].x = msg->poses[i].pose.position.x;
+        path[i].y = msg->poses[i].pose.position.y;
+        path[i].yaw = tf::getYaw(msg->poses[i].pose.orientation);
+    }
+    planner.set_path(path);
+    if(replay.is_open()) write_replay_path(replay, path);
 }
 
-void gpath_callback(const nav_msgs::Path::ConstPtr& msg)
+void Dwa::amcl_callback(const geometry_msgs::PoseStamped::ConstPtr& msg)
 {
-    roomba_gpath = *msg;
+    roomba_status = msg;
 }
 
-void amcl_callback(const geometry_msgs::PoseStamped::ConstPtr& msg)
+void Dwa::nav_function_callback(const chibi19_a::NavigationFunction::ConstPtr& msg)
 {
-    roomba_status = *msg;
-    get_pose = true;
+    Nav_grid grid;
+
+    grid.resolution = msg->info.resolution;
+    grid.origin_x = msg->info.origin.position.x;
+    grid.origin_y = msg->info.origin.position.y;
+    grid.width = msg->info.width;
+    grid.height = msg->info.height;
+    grid.data = msg->data;
+    planner.set_nav_function(grid);
 }
 
-void line_detection_callback(const std_msgs::Bool::ConstPtr& msg){
+void Dwa::line_detection_callback(const std_msgs::Bool::ConstPtr& msg){
     line_detection = msg->data;
 }
 
-int main(int argc, char **argv)
+//1周期分の制御(scan_callbackから呼ぶ)
+void Dwa::control(void)
 {
-    ros::init(argc, argv, "dwa");
-    ros::NodeHandle n;
-    ros::NodeHandle nh("~");
-    ros::Publisher roomba_cntl_pub = n.advertise<roomba_500driver_meiji::RoombaCtrl>("roomba/control", 1);
-    ros::Publisher lpath_pub = n.advertise<nav_msgs::Path>("lpath", 1);
-    ros::Publisher gpath_goal_pub = n.advertise<geometry_msgs::PoseStamped>("gpath_goal", 1);
-    ros::Subscriber roomba_odom_sub = n.subscribe("roomba/odometry", 1, odom_callback);
-    ros::Subscriber roomba_scan_sub = n.subscribe("scan",1, scan_callback);
-    ros::Subscriber roomba_gpath_sub = n.subscribe("gpath", 1, gpath_callback);
-    ros::Subscriber roomba_status_sub = n.subscribe("amcl_pose", 1, amcl_callback);
-    ros::Subscriber line_detection_sub = n.subscribe("detection", 1, line_detection_callback);
-    ros::Rate loop_rate(4.0);
-
-    nh.param("dt", dt, 0.0);
-    nh.param("dv", dv, 0.0);
-    nh.param("dyaw", dyaw, 0.0);
-    nh.param("stop_time", stop_time, 0.0);
-    nh.param("max_speed", max_speed, 0.0);
-    nh.param("min_speed", min_speed, 0.0);
-    nh.param("max_accel", max_accel, 0.0);
-    nh.param("ignore_line", ignore_line, 0.0);
-    nh.param("limit_speed", limit_speed, 0.0);
-    nh.param("max_yawrate", max_yawrate, 0.0);
-    nh.param("predict_time", predict_time, 0.0);
-    nh.param("max_dyawrate", max_dyawrate, 0.0);
-    nh.param("limit_yawrate", limit_yawrate, 0.0);
-    nh.param("roomba_radius", roomba_radius, 0.0);
-    nh.param("l_ob_cost_gain", l_ob_cost_gain, 0.0);
-    nh.param("to_g_goal_cost_gain", to_g_goal_cost_gain, 0.0);
-
-    roomba_500driver_meiji::RoombaCtrl roomba_cntl;
-
     Speed output = {0.0, 0.0};
     Status g_roomba = {0.0, 0.0, 0.0, 0.0, 0.0};
     Position g_goal = {0.0, 0.0, 0.0};
-    Position detected_line = {0.0, 0.0, 0.0};
     bool flags = false;
     bool normalized = false;
-    bool invalid_l_d = false;
     double line_dist = 0.0;
-    std::chrono::system_clock::time_point start, end;
-
-    while (ros::ok()){
-        start = std::chrono::system_clock::now();
-        output.v = 0.0;
-        output.omega = 0.0;
-        normalized = is_normalized(roomba_status.pose.orientation);
-        flags = !roomba_scan.ranges.empty() && !roomba_gpath.poses.empty() && normalized && get_odom && get_pose;
-
-        if(flags){
-            //goal設定
-            g_goal.x = roomba_gpath.poses.back().pose.position.x;
-            g_goal.y = roomba_gpath.poses.back().pose.position.y;
-
-            //現在位置設定
-            g_roomba.x = roomba_status.pose.position.x;
-            g_roomba.y = roomba_status.pose.position.y;
-            g_roomba.yaw = tf::getYaw(roomba_status.pose.orientation);
-            if(roomba_odom.twist.twist.linear.x < 0.5) {
-                g_roomba.v = max_speed*roomba_odom.twist.twist.linear.x;
-            } else {
-                g_roomba.v = max_speed;
-            }
-            g_roomba.omega = max_yawrate*roomba_odom.twist.twist.angular.z;
-
-            //白線検知
-            if(line_detection && !invalid_l_d){
-                roomba_cntl.mode = 0;
-                roomba_cntl.cntl.linear.x = 0.0;
-                roomba_cntl.cntl.angular.z = 0.0;
-                roomba_cntl_pub.publish(roomba_cntl);
-                ros::Duration(stop_time).sleep();
-                invalid_l_d = true;
-                detected_line.x = g_roomba.x;
-                detected_line.y = g_roomba.y;
-            }
+    int mode = 0;
 
-            //白線を検知して止まった場所からの距離を計算
-            if(invalid_l_d){
-                line_dist = calc_dist(g_roomba.x, detected_line.x, g_roomba.y, detected_line.y);
-                if(line_dist > ignore_line) invalid_l_d = false;
-            }
+    normalized = roomba_status && is_normalized(roomba_status->pose.orientation);
+    flags = !roomba_scan.ranges.empty() && roomba_gpath && !roomba_gpath->poses.empty() && normalized && roomba_odom;
 
+    if(!flags){
+        state = WAITING;
+    } else {
+        //goal設定
+        g_goal.x = roomba_gpath->poses.back().pose.position.x;
+        g_goal.y = roomba_gpath->poses.back().pose.position.y;
+
+        //現在位置設定
+        g_roomba.x = roomba_status->pose.position.x;
+        g_roomba.y = roomba_status->pose.position.y;
+        g_roomba.yaw = tf::getYaw(roomba_status->pose.orientation);
+        if(roomba_odom->twist.twist.linear.x < 0.5) {
+            g_roomba.v = max_speed*roomba_odom->twist.twist.linear.x;
+        } else {
+            g_roomba.v = max_speed;
+        }
+        g_roomba.omega = max_yawrate*roomba_odom->twist.twist.angular.z;
+
+        if(state == WAITING) state = TRACKING;
+
+        //白線検知(止まるのはsleepではなく、stop_timeが過ぎるまでLINE_STOPでいる)
+        if(state == TRACKING && line_detection && !invalid_l_d){
+            state = LINE_STOP;
+            line_stop_end = ros::Time::now() + ros::Duration(stop_time);
+            invalid_l_d = true;
+            detected_line.x = g_roomba.x;
+            detected_line.y = g_roomba.y;
+        }
+        if(state == LINE_STOP && ros::Time::now() >= line_stop_end) state = TRACKING;
+
+        //白線を検知して止まった場所からの距離を計算
+        if(invalid_l_d){
+            line_dist = calc_dist(g_roomba.x, detected_line.x, g_roomba.y, detected_line.y);
+            if(line_dist > ignore_line) invalid_l_d = false;
+        }
+
+        //新しいgoalのgpathが来たら追従し直す
+        if(state == GOAL_REACHED && calc_dist(g_goal.x, reached_goal.x, g_goal.y, reached_goal.y) > roomba_radius){
+            state = TRACKING;
+            planner.reset_goal();
+            if(replay.is_open()) write_replay_reset_goal(replay);
+        }
+
+        //使う推定位置の元のscanからの遅延(amcl_poseのstampはそのscanのstamp)
+        monitor.record("pose_age", roomba_status->header.stamp, ros::Time::now());
+
+        if(state == TRACKING){
             //出力速度の計算
-            output = dwa_control(g_roomba, roomba_scan.ranges, roomba_gpath);
-
-            roomba_cntl.mode = is_goal(g_roomba, g_goal);
-            roomba_cntl.cntl.linear.x = output.v/(2*max_speed);
-            roomba_cntl.cntl.angular.z = output.omega/max_yawrate;
-            roomba_cntl_pub.publish(roomba_cntl);
-            lpath_pub.publish(lpath);
-            gpath_goal_pub.publish(gpath_goal);
+            if(replay.is_open()) write_replay_cycle(replay, g_roomba, roomba_scan);
+            ros::Time begin = ros::Time::now();
+            output = planner.control(g_roomba, roomba_scan);
+            monitor.record("control", scan_stamp, begin, ros::Time::now());
+            log_best_traj(planner.get_best_traj());
+            log_gpath_goal(planner.get_target());
+
+            mode = is_goal(g_roomba, g_goal);
+            if(mode == 0){
+                state = GOAL_REACHED;
+                reached_goal = g_goal;
+            }
         }
-        end = std::chrono::system_clock::now();
-        auto msec = std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count();
-        std::cout << "Duration = " << msec << " msec" << std::endl;
-        ros::spinOnce();
-        loop_rate.sleep();
-    }
 
-    return 0;
+        publish_cntl(mode, output.v/(2*max_speed), output.omega/max_yawrate);
+        //scanからRoombaCtrlを出すまで
+        monitor.record("command", scan_stamp, ros::Time::now());
+        lpath_pub.publish(lpath);
+        gpath_goal_pub.publish(gpath_goal);
+    }
 }
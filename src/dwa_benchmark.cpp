@@ -0,0 +1,368 @@
+//局所経路計画のreplayベンチマーク(ROSに依存しない、roscoreなしで動く)
+//dwaノードのreplay_fileで記録した(gpath, 姿勢, scan)の列、または生成した通路のシナリオを再生し、
+//設定ごとに1周期の時間の分布、評価したサンプル/秒と下限で打ち切ったサンプル/秒、選んだ(v, omega)を出力する
+//2番目以降の設定は選んだ(v, omega)が1番目と同じ周期数も出す(スレッド数やbatchは同じになるはず)
+//
+//usage: dwa_benchmark [-p dwa.yaml] [-r replay.txt] [-o decisions.txt] [-s seed] [-c key=value[,key=value...]]...
+//(-cでscan_maskを変えるときは"scan_mask=0.8 1.3"のように空白で区切る)
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <chrono>
+#include <fstream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include "chibi19_a/local_planner.h"
+
+namespace
+{
+struct Config{
+	std::string name;
+	Local_planner_params params;
+};
+
+struct Result{
+	std::vector<Speed> outputs;
+	std::vector<double> msec;
+	long samples;
+	long pruned;
+};
+
+std::string trim(const std::string& s)
+{
+	const size_t begin = s.find_first_not_of(" \t\r\"'");
+	const size_t end = s.find_last_not_of(" \t\r\"'");
+	if(begin == std::string::npos)
+		return "";
+	return s.substr(begin, end - begin + 1);
+}
+
+//"[a, b, ...]"または"a b ..."
+std::vector<double> parse_list(const std::string& value)
+{
+	std::string s = value;
+	std::vector<double> list;
+	double x;
+
+	std::replace(s.begin(), s.end(), '[', ' ');
+	std::replace(s.begin(), s.end(), ']', ' ');
+	std::replace(s.begin(), s.end(), ',', ' ');
+	std::istringstream in(s);
+	while(in >> x) list.push_back(x);
+	return list;
+}
+
+//dwa.yamlと同じ名前の値を設定する(知らない名前はfalse)
+bool set_param(Local_planner_params& p, const std::string& key, const std::string& value)
+{
+	const double d = atof(value.c_str());
+	const bool b = value == "true" || value == "True" || value == "1";
+
+	if(key == "dt") p.dt = d;
+	else if(key == "dv") p.dv = d;
+	else if(key == "dyaw") p.dyaw = d;
+	else if(key == "min_speed") p.min_speed = d;
+	else if(key == "max_accel") p.max_accel = d;
+	else if(key == "limit_speed") p.limit_speed = d;
+	else if(key == "max_dyawrate") p.max_dyawrate = d;
+	else if(key == "limit_yawrate") p.limit_yawrate = d;
+	else if(key == "predict_time") p.predict_time = d;
+	else if(key == "roomba_radius") p.roomba_radius = d;
+	else if(key == "l_ob_cost_gain") p.l_ob_cost_gain = d;
+	else if(key == "to_g_goal_cost_gain") p.to_g_goal_cost_gain = d;
+	else if(key == "nav_cost_gain") p.nav_cost_gain = d;
+	else if(key == "path_cost_gain") p.path_cost_gain = d;
+	else if(key == "heading_cost_gain") p.heading_cost_gain = d;
+	else if(key == "speed_cost_gain") p.speed_cost_gain = d;
+	else if(key == "smoothness_cost_gain") p.smoothness_cost_gain = d;
+	else if(key == "use_nav_function") p.use_nav_function = b;
+	else if(key == "ob_grid_resolution") p.ob_grid_resolution = d;
+	else if(key == "ob_dist_max") p.ob_dist_max = d;
+	else if(key == "scan_mask") p.scan_filter.mask = parse_list(value);
+	else if(key == "scan_beam_step") p.scan_filter.beam_step = atoi(value.c_str());
+	else if(key == "scan_max_beams") p.scan_filter.max_beams = atoi(value.c_str());
+	else if(key == "num_threads") p.num_threads = atoi(value.c_str());
+	else if(key == "controller") p.controller = value;
+	else if(key == "rollout_mode") p.rollout_mode = value;
+	else if(key == "clearance_mode") p.clearance_mode = value;
+	else if(key == "sampling_mode") p.sampling_mode = value;
+	else if(key == "time_budget") p.time_budget = d;
+	else if(key == "mppi_samples") p.mppi_samples = atoi(value.c_str());
+	else if(key == "mppi_lambda") p.mppi_lambda = d;
+	else if(key == "mppi_sigma_v") p.mppi_sigma_v = d;
+	else if(key == "mppi_sigma_omega") p.mppi_sigma_omega = d;
+	else return false;
+	return true;
+}
+
+//"key: value"が並ぶだけのyamlを読む(dwa.yamlはこの形)
+bool load_yaml(const std::string& filename, Local_planner_params& p)
+{
+	std::ifstream in(filename.c_str());
+	std::string line;
+
+	if(!in)
+		return false;
+	while(std::getline(in, line)){
+		line = line.substr(0, line.find('#'));
+		const size_t colon = line.find(':');
+		if(colon == std::string::npos)
+			continue;
+		set_param(p, trim(line.substr(0, colon)), trim(line.substr(colon + 1)));
+	}
+	return true;
+}
+
+//"key=value,key=value"で上書きした設定
+bool parse_config(const std::string& spec, const Local_planner_params& base, Config& config)
+{
+	std::istringstream fields(spec);
+	std::string field;
+
+	config.name = spec;
+	config.params = base;
+	while(std::getline(fields, field, ',')){
+		const size_t eq = field.find('=');
+		if(eq == std::string::npos || !set_param(config.params, field.substr(0, eq), field.substr(eq + 1))){
+			fprintf(stderr, "unknown setting: %s\n", field.c_str());
+			return false;
+		}
+	}
+	return true;
+}
+
+//幅1.2mの通路(x方向)に、左右から交互に箱を置いたシナリオ(箱の間隔は約1m)
+//scanは姿勢からの光線と壁・箱の交点で作る
+struct Corridor{
+	struct Box{
+		double min_x;
+		double max_x;
+		double min_y;
+		double max_y;
+	};
+	double half_width;
+	std::vector<Box> boxes;
+
+	bool hit(const double x, const double y) const
+	{
+		if(std::fabs(y) >= half_width)
+			return true;
+		for(int i = 0; i < boxes.size(); i++){
+			if(boxes[i].min_x <= x && x <= boxes[i].max_x && boxes[i].min_y <= y && y <= boxes[i].max_y)
+				return true;
+		}
+		return false;
+	}
+
+	void scan(const Status& roomba, Scan& scan) const
+	{
+		const int beams = 683;
+		const double step = 0.01;
+		scan.angle_min = -2.09;
+		scan.angle_increment = 4.18/(beams - 1);
+		scan.range_min = 0.02;
+		scan.range_max = 5.6;
+		scan.ranges.assign(beams, scan.range_max + 1.0);
+		for(int i = 0; i < beams; i++){
+			const double a = roomba.yaw + scan.angle_min + i*scan.angle_increment;
+			const double c = std::cos(a);
+			const double s = std::sin(a);
+			for(double t = scan.range_min; t < scan.range_max; t += step){
+				if(hit(roomba.x + c*t, roomba.y + s*t)){
+					scan.ranges[i] = t;
+					break;
+				}
+			}
+		}
+	}
+};
+
+//基準の設定でシナリオを閉ループで走らせ、各周期の入力を記録する
+std::vector<Replay_frame> make_corridor_frames(const Local_planner_params& params, unsigned int seed)
+{
+	const int max_cycles = 1500;
+	const double length = 4.0;
+	std::mt19937 rng(seed);
+	std::uniform_real_distribution<double> jitter(-0.1, 0.1);
+	std::vector<Replay_frame> frames;
+	std::vector<Position> path;
+	Corridor corridor;
+	Local_planner planner;
+	Status roomba = {0.0, 0.0, 0.0, 0.0, 0.0};
+
+	corridor.half_width = 0.6;
+	for(int i = 0; i < 3; i++){
+		Corridor::Box box;
+		box.min_x = 1.0 + 1.0*i + jitter(rng);
+		box.max_x = box.min_x + 0.2;
+		box.min_y = i%2 ? 0.1 : -0.6;
+		box.max_y = i%2 ? 0.6 : -0.1;
+		corridor.boxes.push_back(box);
+	}
+	//gpathは箱の前後で反対側に寄る
+	for(int i = 0; i <= length/0.05; i++){
+		Position p = {0.05*i, 0.0, 0.0};
+		for(int j = 0; j < corridor.boxes.size(); j++){
+			const Corridor::Box& box = corridor.boxes[j];
+			if(box.min_x - 0.3 <= p.x && p.x <= box.max_x + 0.3)
+				p.y = box.min_y < 0.0 ? 0.3 : -0.3;
+		}
+		path.push_back(p);
+	}
+
+	planner.init(params);
+	planner.set_path(path);
+	for(int cycle = 0; cycle < max_cycles && roomba.x < length - 0.3; cycle++){
+		Replay_frame frame;
+		frame.new_path = cycle == 0;
+		frame.reset_goal = false;
+		if(frame.new_path)
+			frame.path = path;
+		frame.roomba = roomba;
+		corridor.scan(roomba, frame.scan);
+		frames.push_back(frame);
+
+		Speed output = planner.control(roomba, frame.scan);
+		roomba.yaw += output.omega*params.dt;
+		roomba.x += output.v*std::cos(roomba.yaw)*params.dt;
+		roomba.y += output.v*std::sin(roomba.yaw)*params.dt;
+		roomba.v = output.v;
+		roomba.omega = output.omega;
+	}
+	return frames;
+}
+
+Result run(const Config& config, const std::vector<Replay_frame>& frames)
+{
+	Local_planner planner;
+	Result result;
+
+	result.samples = 0;
+	result.pruned = 0;
+	planner.init(config.params);
+	for(int i = 0; i < frames.size(); i++){
+		if(frames[i].new_path)
+			planner.set_path(frames[i].path);
+		if(frames[i].reset_goal)
+			planner.reset_goal();
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		Speed output = planner.control(frames[i].roomba, frames[i].scan);
+		std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+		result.outputs.push_back(output);
+		result.msec.push_back(std::chrono::duration<double, std::milli>(end - start).count());
+		result.samples += planner.get_samples();
+		result.pruned += planner.get_pruned();
+	}
+	return result;
+}
+
+double percentile(std::vector<double> values, const double q)
+{
+	if(values.empty())
+		return 0.0;
+	std::sort(values.begin(), values.end());
+	return values[std::min((int)(q*values.size()), (int)values.size() - 1)];
+}
+}
+
+int main(int argc, char** argv)
+{
+	Local_planner_params base;
+	std::string replay_file;
+	std::string decisions_file;
+	std::vector<std::string> specs;
+	unsigned int seed = 1;
+
+	for(int i = 1; i < argc; i++){
+		if(!strcmp(argv[i], "-p") && i+1 < argc){
+			if(!load_yaml(argv[++i], base)){
+				fprintf(stderr, "cannot read %s\n", argv[i]);
+				return 1;
+			}
+		}else if(!strcmp(argv[i], "-r") && i+1 < argc)
+			replay_file = argv[++i];
+		else if(!strcmp(argv[i], "-o") && i+1 < argc)
+			decisions_file = argv[++i];
+		else if(!strcmp(argv[i], "-s") && i+1 < argc)
+			seed = strtoul(argv[++i], NULL, 10);
+		else if(!strcmp(argv[i], "-c") && i+1 < argc)
+			specs.push_back(argv[++i]);
+		else{
+			fprintf(stderr, "usage: %s [-p dwa.yaml] [-r replay.txt] [-o decisions.txt] [-s seed] [-c key=value[,key=value...]]...\n", argv[0]);
+			return 1;
+		}
+	}
+	//ベンチマークでは内訳を表示しない
+	base.print_cost_breakdown = false;
+
+	std::vector<Config> configs(1);
+	configs[0].name = "base";
+	configs[0].params = base;
+	if(specs.empty()){
+		specs.push_back("num_threads=4");
+		specs.push_back("rollout_mode=batch");
+		specs.push_back("sampling_mode=adaptive");
+		specs.push_back("controller=mppi");
+	}
+	for(int i = 0; i < specs.size(); i++){
+		Config config;
+		if(!parse_config(specs[i], base, config))
+			return 1;
+		configs.push_back(config);
+	}
+
+	std::vector<Replay_frame> frames;
+	if(!replay_file.empty()){
+		std::ifstream in(replay_file.c_str());
+		Replay_frame frame;
+		if(!in){
+			fprintf(stderr, "cannot read %s\n", replay_file.c_str());
+			return 1;
+		}
+		while(read_replay_frame(in, frame))
+			frames.push_back(frame);
+		printf("replay %s: %d cycles\n", replay_file.c_str(), (int)frames.size());
+	}else{
+		frames = make_corridor_frames(base, seed);
+		printf("corridor (seed %u): %d cycles, end (%.2f, %.2f)\n", seed, (int)frames.size(),
+				frames.back().roomba.x, frames.back().roomba.y);
+	}
+	if(frames.empty())
+		return 1;
+
+	//samples/sは障害物のコストまで評価したサンプル、pruned/sは下限で打ち切ったサンプル
+	printf("%-28s %8s %8s %8s %8s %12s %12s %8s\n", "config", "p50[ms]", "p90[ms]", "p99[ms]", "max[ms]", "samples/s", "pruned/s", "same");
+	std::vector<Result> results;
+	for(int c = 0; c < configs.size(); c++){
+		results.push_back(run(configs[c], frames));
+		const Result& r = results.back();
+		double total = 0.0;
+		int same = 0;
+		for(int i = 0; i < r.msec.size(); i++){
+			total += r.msec[i];
+			same += r.outputs[i].v == results[0].outputs[i].v && r.outputs[i].omega == results[0].outputs[i].omega;
+		}
+		printf("%-28s %8.3f %8.3f %8.3f %8.3f %12.0f %12.0f %4d/%-4d\n", configs[c].name.c_str(),
+				percentile(r.msec, 0.5), percentile(r.msec, 0.9), percentile(r.msec, 0.99), percentile(r.msec, 1.0),
+				total > 0.0 ? r.samples/(total*1e-3) : 0.0, total > 0.0 ? r.pruned/(total*1e-3) : 0.0, same, (int)r.msec.size());
+	}
+
+	//基準の設定の出力(別のビルドの出力とdiffすれば、判断が変わっていないか確かめられる)
+	if(!decisions_file.empty()){
+		FILE* out = fopen(decisions_file.c_str(), "w");
+		if(out == NULL){
+			fprintf(stderr, "cannot write %s\n", decisions_file.c_str());
+			return 1;
+		}
+		for(int i = 0; i < results[0].outputs.size(); i++)
+			fprintf(out, "%d %.17g %.17g\n", i, results[0].outputs[i].v, results[0].outputs[i].omega);
+		fclose(out);
+	}
+
+	return 0;
+}
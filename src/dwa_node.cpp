@@ -0,0 +1,13 @@
+#include "chibi19_a/dwa_node.h"
+
+int main(int argc, char **argv)
+{
+    ros::init(argc, argv, "dwa");
+    ros::NodeHandle n;
+    ros::NodeHandle nh("~");
+
+    Dwa dwa(n, nh);
+    ros::spin();
+
+    return 0;
+}
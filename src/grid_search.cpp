@@ -0,0 +1,48 @@
+#include "chibi19_a/grid_search.h"
+
+namespace
+{
+template <class Neighborhood, class CostModel>
+Grid_search_base* create_with_heuristic(const std::string& heuristic, const Navigation_function* nav)
+{
+	if(heuristic == "manhattan"){
+		return new Grid_search<Neighborhood, Manhattan_heuristic, CostModel>(Manhattan_heuristic());
+	} else if(heuristic == "octile"){
+		return new Grid_search<Neighborhood, Octile_heuristic, CostModel>(Octile_heuristic());
+	} else if(heuristic == "euclidean"){
+		return new Grid_search<Neighborhood, Euclidean_heuristic, CostModel>(Euclidean_heuristic());
+	} else if(heuristic == "nav_function" && nav != NULL){
+		Precomputed_heuristic h = {nav};
+		return new Grid_search<Neighborhood, Precomputed_heuristic, CostModel>(h);
+	}
+	return NULL;
+}
+
+template <class Neighborhood>
+Grid_search_base* create_with_cost_model(const std::string& heuristic, const std::string& cost_model, const Navigation_function* nav)
+{
+	if(cost_model == "cost_map"){
+		return create_with_heuristic<Neighborhood, Cost_map_cost>(heuristic, nav);
+	} else if(cost_model == "uniform"){
+		return create_with_heuristic<Neighborhood, Uniform_cost>(heuristic, nav);
+	}
+	return NULL;
+}
+}
+
+bool is_admissible(int neighborhood, const std::string& heuristic)
+{
+	return neighborhood != 8 || (heuristic != "manhattan" && heuristic != "nav_function");
+}
+
+Grid_search_base* create_grid_search(int neighborhood, const std::string& heuristic, const std::string& cost_model, const Navigation_function* nav)
+{
+	if(neighborhood == 4){
+		return create_with_cost_model<Four_connected>(heuristic, cost_model, nav);
+	} else if(neighborhood == 8){
+		if(!is_admissible(neighborhood, heuristic))
+			return NULL;
+		return create_with_cost_model<Eight_connected>(heuristic, cost_model, nav);
+	}
+	return NULL;
+}
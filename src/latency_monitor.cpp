@@ -0,0 +1,197 @@
+#include "chibi19_a/latency_monitor.h"
+#include "diagnostic_msgs/DiagnosticArray.h"
+#include <algorithm>
+#include <functional>
+#include <cstdio>
+#include <sstream>
+
+namespace
+{
+//ヒストグラムの各binの上端[ms](最後のbinはそれより大きいものすべて)
+const double BIN_EDGES[] = {1.0, 2.0, 5.0, 10.0, 20.0, 50.0, 100.0, 200.0, 500.0, 1000.0};
+const int BIN_SIZE = sizeof(BIN_EDGES)/sizeof(BIN_EDGES[0]);
+
+double percentile(const std::vector<double>& sorted, double p)
+{
+	if(sorted.empty())
+		return 0.0;
+	return sorted[std::min((int)(p*sorted.size()), (int)sorted.size() - 1)];
+}
+
+std::string format(double x)
+{
+	char buf[32];
+	snprintf(buf, sizeof(buf), "%.2f", x);
+	return buf;
+}
+
+void add_value(diagnostic_msgs::DiagnosticStatus& status, const std::string& key, const std::string& value)
+{
+	diagnostic_msgs::KeyValue kv;
+	kv.key = key;
+	kv.value = value;
+	status.values.push_back(kv);
+}
+
+//"<=1ms:3 <=2ms:10 ... >1000ms:0"
+std::string histogram(const std::vector<double>& sorted)
+{
+	std::ostringstream ss;
+	int j = 0;
+
+	for(int i = 0; i <= BIN_SIZE; i++){
+		int n = 0;
+		while(j < sorted.size() && (i == BIN_SIZE || sorted[j] <= BIN_EDGES[i])){
+			n++;
+			j++;
+		}
+		if(i > 0)
+			ss << ' ';
+		if(i < BIN_SIZE)
+			ss << "<=" << BIN_EDGES[i] << "ms:" << n;
+		else
+			ss << '>' << BIN_EDGES[BIN_SIZE - 1] << "ms:" << n;
+	}
+	return ss.str();
+}
+}
+
+Latency_monitor::Latency_monitor(void)
+{
+	pid = 0;
+	first_event = true;
+}
+
+Latency_monitor::~Latency_monitor(void)
+{
+	std::lock_guard<std::mutex> lock(mtx);
+
+	if(!trace.is_open())
+		return;
+	for(int i = 0; i < events.size(); i++){
+		write_event(events[i]);
+	}
+	trace << "\n]\n";
+}
+
+void Latency_monitor::init(ros::NodeHandle& nh, ros::NodeHandle& private_nh, const std::string& node_name)
+{
+	double period;
+	std::string trace_file;
+
+	name = node_name;
+	//nodeletでは同じプロセスに載るので、traceの"pid"はノード名から決める
+	pid = std::hash<std::string>()(name) % 100000;
+	private_nh.param("diagnostics_period", period, 1.0);
+	//相対パスはROS_HOME(通常~/.ros)からになる
+	private_nh.param("trace_file", trace_file, std::string(""));
+	if(!trace_file.empty()){
+		trace.open(trace_file.c_str());
+		if(!trace){
+			ROS_WARN("cannot open %s", trace_file.c_str());
+		} else {
+			trace << "[";
+			write_metadata("process_name", 0, name);
+		}
+	}
+
+	diagnostics_pub = nh.advertise<diagnostic_msgs::DiagnosticArray>("/diagnostics", 1);
+	if(period > 0.0)
+		timer = nh.createTimer(ros::Duration(period), &Latency_monitor::publish, this);
+}
+
+void Latency_monitor::record(const std::string& stage, const ros::Time& source, const ros::Time& begin, const ros::Time& end)
+{
+	std::lock_guard<std::mutex> lock(mtx);
+	std::map<std::string, std::vector<double> >::iterator it = samples.find(stage);
+
+	if(it == samples.end()){
+		stage_order.push_back(stage);
+		it = samples.insert(std::make_pair(stage, std::vector<double>())).first;
+		if(trace.is_open())
+			write_metadata("thread_name", stage_order.size(), stage);
+	}
+	it->second.push_back((end - source).toSec()*1000.0);
+	if(trace.is_open()){
+		Trace_event e = {stage, source.toSec(), begin.toSec(), end.toSec()};
+		events.push_back(e);
+	}
+}
+
+void Latency_monitor::record(const std::string& stage, const ros::Time& source, const ros::Time& t)
+{
+	record(stage, source, t, t);
+}
+
+//段階ごとにtraceの"tid"を分ける(最初に記録した順に1, 2, ...)
+int Latency_monitor::get_tid(const std::string& stage) const
+{
+	return std::find(stage_order.begin(), stage_order.end(), stage) - stage_order.begin() + 1;
+}
+
+void Latency_monitor::write_metadata(const char* type, int tid, const std::string& value)
+{
+	trace << (first_event ? "\n" : ",\n");
+	trace << "{\"name\":\"" << type << "\",\"ph\":\"M\",\"pid\":" << pid << ",\"tid\":" << tid
+		<< ",\"args\":{\"name\":\"" << value << "\"}}";
+	first_event = false;
+}
+
+//時間のある段階は"X"(区間)、時刻だけのものは"i"(瞬間)にする。ts, durは[us]
+void Latency_monitor::write_event(const Trace_event& e)
+{
+	char buf[256];
+	char scan[32];
+
+	if(e.end > e.begin){
+		snprintf(buf, sizeof(buf), "\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f", e.begin*1e6, (e.end - e.begin)*1e6);
+	} else {
+		snprintf(buf, sizeof(buf), "\"ph\":\"i\",\"s\":\"t\",\"ts\":%.3f", e.end*1e6);
+	}
+	snprintf(scan, sizeof(scan), "%.9f", e.source);
+	trace << (first_event ? "\n" : ",\n");
+	trace << "{\"name\":\"" << e.stage << "\",\"cat\":\"" << name << "\"," << buf
+		<< ",\"pid\":" << pid << ",\"tid\":" << get_tid(e.stage)
+		<< ",\"args\":{\"scan\":\"" << scan << "\",\"latency_ms\":" << format((e.end - e.source)*1000.0) << "}}";
+	first_event = false;
+}
+
+void Latency_monitor::publish(const ros::TimerEvent&)
+{
+	diagnostic_msgs::DiagnosticArray::Ptr msg(new diagnostic_msgs::DiagnosticArray);
+	diagnostic_msgs::DiagnosticStatus status;
+
+	status.level = diagnostic_msgs::DiagnosticStatus::OK;
+	status.name = name + ": latency";
+	status.hardware_id = name;
+	{
+		std::lock_guard<std::mutex> lock(mtx);
+
+		status.message = "source scan to each stage [ms]";
+		for(int i = 0; i < stage_order.size(); i++){
+			const std::string& stage = stage_order[i];
+			std::vector<double>& latency = samples[stage];
+
+			std::sort(latency.begin(), latency.end());
+			add_value(status, stage + " count", std::to_string(latency.size()));
+			add_value(status, stage + " p50", format(percentile(latency, 0.5)));
+			add_value(status, stage + " p90", format(percentile(latency, 0.9)));
+			add_value(status, stage + " p99", format(percentile(latency, 0.99)));
+			add_value(status, stage + " max", format(latency.empty() ? 0.0 : latency.back()));
+			add_value(status, stage + " histogram", histogram(latency));
+			latency.clear();
+		}
+
+		if(trace.is_open()){
+			for(int i = 0; i < events.size(); i++){
+				write_event(events[i]);
+			}
+			trace.flush();
+		}
+		events.clear();
+	}
+
+	msg->header.stamp = ros::Time::now();
+	msg->status.push_back(status);
+	diagnostics_pub.publish(msg);
+}
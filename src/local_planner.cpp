@@ -0,0 +1,1364 @@
+#include "chibi19_a/local_planner.h"
+#include <cmath>
+#include <limits>
+#include <sstream>
+#include <iostream>
+#include <algorithm>
+
+namespace
+{
+const double EPS = 1e-6;
+//これ以上のコスト(infを含む)の軌道は選ばない
+const double MAX_COST = 1000.0;
+
+struct Dw{
+	double min_v;
+	double max_v;
+	double min_omega;
+	double max_omega;
+};
+
+void angle_range(double& theta)
+{
+	if(theta > M_PI){
+		theta -= 2*M_PI;
+	} else if(theta < -M_PI){
+		theta += 2*M_PI;
+	}
+	return;
+}
+
+double atan(const double x, const double y)
+{
+	double theta = 0.0;
+
+	if(std::fabs(x) <= EPS){
+		if(std::fabs(y) <= EPS){
+			theta = 0.0;
+		} else if(y < -EPS) {
+			theta = -M_PI/2;
+		} else if(y > EPS) {
+			theta = M_PI/2;
+		}
+	} else {
+		theta = std::atan2(y, x);
+		angle_range(theta);
+	}
+
+	return theta;
+}
+
+//二点間の距離を計算
+double calc_dist(const double x1, const double x2, const double y1, const double y2)
+{
+	double dx = x1 - x2;
+	double dy = y1 - y2;
+
+	return std::sqrt(dx*dx + dy*dy);
+}
+
+//全部local
+void motion(Status& roomba, const double v, const double y, const double dt)
+{
+	roomba.yaw += y*dt;
+	angle_range(roomba.yaw);
+	roomba.x += v*std::cos(roomba.yaw)*dt;
+	roomba.y += v*std::sin(roomba.yaw)*dt;
+	roomba.v = v;
+	roomba.omega = y;
+	return;
+}
+
+//全部local
+void calc_l_traj(std::vector<Status>& traj, const double v, const double y, const Local_planner_params& p)
+{
+	Status roomba = {0.0, 0.0, 0.0, 0.0, 0.0};
+	const int elements_t = int(p.predict_time/p.dt);
+
+	traj.clear();
+	for(int t_i = 0; t_i < elements_t; t_i++){
+		traj.push_back(roomba);
+		motion(roomba, v, y, p.dt);
+	}
+	traj.push_back(roomba);
+	return;
+}
+
+void calc_dynamic_window(Dw& dw, const Status& roomba, const Local_planner_params& p)
+{
+	const Dw Vs = {
+		p.min_speed,
+		p.limit_speed,
+		-p.limit_yawrate,
+		p.limit_yawrate
+	};
+	Dw Vd = {
+		roomba.v - p.max_accel*p.dt,
+		roomba.v + p.max_accel*p.dt,
+		roomba.omega - p.max_dyawrate*p.dt,
+		roomba.omega + p.max_dyawrate*p.dt
+	};
+	dw.min_v = std::max(Vs.min_v, Vd.min_v);
+	dw.max_v = std::min(Vs.max_v, Vd.max_v);
+	dw.min_omega = std::max(Vs.min_omega, Vd.min_omega);
+	dw.max_omega = std::min(Vs.max_omega, Vd.max_omega);
+	return;
+}
+
+//コストが小さい方、同じなら通し番号が小さい方を良いとする
+template<typename Result>
+bool is_better(const Result& a, const Result& b)
+{
+	return a.cost < b.cost || (a.cost == b.cost && a.index < b.index);
+}
+}
+
+Local_planner_params::Local_planner_params(void)
+{
+	dt = 0.1;
+	dv = 0.01;
+	dyaw = 0.01;
+	min_speed = 0.0;
+	max_accel = 5.0;
+	limit_speed = 0.10;
+	max_dyawrate = 5.0;
+	limit_yawrate = 0.25;
+	predict_time = 3.0;
+	roomba_radius = 0.16;
+	l_ob_cost_gain = 0.10;
+	to_g_goal_cost_gain = 0.90;
+	nav_cost_gain = 0.90;
+	path_cost_gain = 0.0;
+	heading_cost_gain = 0.0;
+	speed_cost_gain = 0.0;
+	smoothness_cost_gain = 0.0;
+	use_nav_function = false;
+	print_cost_breakdown = false;
+	ob_grid_resolution = 0.02;
+	ob_dist_max = 1.0;
+	num_threads = 1;
+	controller = "dwa";
+	rollout_mode = "library";
+	clearance_mode = "grid";
+	sampling_mode = "lattice";
+	time_budget = 0.02;
+	mppi_samples = 256;
+	mppi_lambda = 0.005;
+	mppi_sigma_v = 0.05;
+	mppi_sigma_omega = 0.3;
+	//左右の支柱
+	const double rods[] = {0.80, 1.30, -1.30, -0.80};
+	scan_filter.mask.assign(rods, rods + 4);
+}
+
+//store_pointsがfalseなら格子の大きさだけ決める(batchでは軌道をその場で積分する)
+void Traj_library::build(const Local_planner_params& p, bool store_points)
+{
+	std::vector<Status> traj;
+
+	v_min = p.min_speed;
+	dv = p.dv;
+	dyaw = p.dyaw;
+	v_size = std::max(int((p.limit_speed - p.min_speed)/p.dv + EPS), 0) + 1;
+	omega_offset = int(p.limit_yawrate/p.dyaw + EPS);
+	omega_size = 2*omega_offset + 1;
+	traj_size = int(p.predict_time/p.dt) + 1;
+
+	points.clear();
+	if(!store_points) return;
+	points.reserve(v_size*omega_size*traj_size);
+	for(int v_i = 0; v_i < v_size; v_i++){
+		for(int omega_i = 0; omega_i < omega_size; omega_i++){
+			calc_l_traj(traj, v(v_i), omega(omega_i), p);
+			points.insert(points.end(), traj.begin(), traj.end());
+		}
+	}
+	return;
+}
+
+void Ob_grid::init(double res, double reach, double max_d)
+{
+	resolution = res;
+	inv_resolution = 1.0/res;
+	max_dist = max_d;
+	size = 2*int(std::ceil((reach + max_dist)/resolution));
+	origin = -0.5*size*resolution;
+	dist.assign(size*size, max_dist);
+	nearest.assign(size*size, -1);
+	bucket_size = std::max(0.1, resolution);
+	bucket_count = std::max(int(std::ceil(size*resolution/bucket_size)), 1);
+	bucket_start.assign(bucket_count*bucket_count + 1, 0);
+	return;
+}
+
+//座標が入るbucketの列(行)番号(格子の外は端に寄せる)
+int Ob_grid::bucket_index(double x) const
+{
+	int i = int(std::floor((x - origin)/bucket_size));
+	return std::min(std::max(i, 0), bucket_count - 1);
+}
+
+//pointsをbucketごとに数えて並べ直す
+void Ob_grid::sort_buckets(void)
+{
+	std::vector<int> bucket(points.size());
+
+	std::fill(bucket_start.begin(), bucket_start.end(), 0);
+	for(int j = 0; j < points.size(); j++){
+		bucket[j] = bucket_index(points[j].x) + bucket_count*bucket_index(points[j].y);
+		bucket_start[bucket[j] + 1]++;
+	}
+	for(int b = 0; b < bucket_count*bucket_count; b++){
+		bucket_start[b + 1] += bucket_start[b];
+	}
+	bucket_points.resize(points.size());
+	std::vector<int> next(bucket_start.begin(), bucket_start.end() - 1);
+	for(int j = 0; j < points.size(); j++){
+		bucket_points[next[bucket[j]]++] = points[j];
+	}
+	return;
+}
+
+//セルiの中心から、隣のセルjが持つ最近点までの距離で更新する
+void Ob_grid::relax(int i, int j)
+{
+	if(nearest[j] < 0 || nearest[j] == nearest[i]) return;
+
+	const Position& p = points[nearest[j]];
+	double cx = origin + (i%size + 0.5)*resolution;
+	double cy = origin + (i/size + 0.5)*resolution;
+	double d = calc_dist(p.x, cx, p.y, cy);
+	if(d < dist[i]){
+		dist[i] = d;
+		nearest[i] = nearest[j];
+	}
+	return;
+}
+
+void Ob_grid::update(const Filtered_scan& scan)
+{
+	const double range = -origin;
+
+	std::fill(dist.begin(), dist.end(), max_dist);
+	std::fill(nearest.begin(), nearest.end(), -1);
+	points.clear();
+
+	//格子内のscan点を一度だけ直交座標にして、その点を含むセルに登録する
+	for(int j = 0; j < scan.beams.size(); j++){
+		const Beam& b = scan.beams[j];
+
+		Position p = {b.range*b.c, b.range*b.s, 0.0};
+		if(std::fabs(p.x) >= range || std::fabs(p.y) >= range) continue;
+		int i = int((p.x - origin)/resolution) + size*int((p.y - origin)/resolution);
+
+		points.push_back(p);
+		double cx = origin + (i%size + 0.5)*resolution;
+		double cy = origin + (i/size + 0.5)*resolution;
+		double d = calc_dist(p.x, cx, p.y, cy);
+		if(d < dist[i]){
+			dist[i] = d;
+			nearest[i] = points.size() - 1;
+		}
+	}
+
+	//最近点を隣に伝える2パスの距離変換
+	for(int y = 0; y < size; y++){
+		for(int x = 0; x < size; x++){
+			int i = x + size*y;
+			if(x > 0) relax(i, i - 1);
+			if(y > 0){
+				relax(i, i - size);
+				if(x > 0) relax(i, i - size - 1);
+				if(x < size - 1) relax(i, i - size + 1);
+			}
+		}
+		for(int x = size - 2; x >= 0; x--){
+			relax(x + size*y, x + size*y + 1);
+		}
+	}
+	for(int y = size - 1; y >= 0; y--){
+		for(int x = size - 1; x >= 0; x--){
+			int i = x + size*y;
+			if(x < size - 1) relax(i, i + 1);
+			if(y < size - 1){
+				relax(i, i + size);
+				if(x > 0) relax(i, i + size - 1);
+				if(x < size - 1) relax(i, i + size + 1);
+			}
+		}
+		for(int x = 1; x < size; x++){
+			relax(x + size*y, x + size*y - 1);
+		}
+	}
+	return;
+}
+
+Worker_pool::Worker_pool(void)
+{
+	job = NULL;
+	generation = 0;
+	pending = 0;
+	stopping = false;
+}
+
+Worker_pool::~Worker_pool(void)
+{
+	stop();
+}
+
+void Worker_pool::start(int num_threads)
+{
+	stop();
+	stopping = false;
+	for(int i = 1; i < num_threads; i++){
+		threads.push_back(std::thread(&Worker_pool::loop, this, i, generation));
+	}
+	return;
+}
+
+void Worker_pool::stop(void)
+{
+	{
+		std::lock_guard<std::mutex> lock(mtx);
+		stopping = true;
+	}
+	work_cv.notify_all();
+	for(int i = 0; i < threads.size(); i++){
+		threads[i].join();
+	}
+	threads.clear();
+	return;
+}
+
+void Worker_pool::run(const std::function<void(int)>& f)
+{
+	{
+		std::lock_guard<std::mutex> lock(mtx);
+		job = &f;
+		pending = threads.size();
+		generation++;
+	}
+	work_cv.notify_all();
+	f(0);
+
+	std::unique_lock<std::mutex> lock(mtx);
+	done_cv.wait(lock, [this]{ return pending == 0; });
+	return;
+}
+
+int Worker_pool::size(void) const
+{
+	return threads.size() + 1;
+}
+
+//seenは最後に実行したrunの番号(起動前のrunは実行しない)
+void Worker_pool::loop(int id, unsigned long seen)
+{
+	while(true){
+		const std::function<void(int)>* f = NULL;
+		{
+			std::unique_lock<std::mutex> lock(mtx);
+			work_cv.wait(lock, [&]{ return stopping || generation != seen; });
+			if(stopping) return;
+			seen = generation;
+			f = job;
+		}
+		(*f)(id);
+		{
+			std::lock_guard<std::mutex> lock(mtx);
+			pending--;
+		}
+		done_cv.notify_one();
+	}
+}
+
+//項の並びをコンパイル時に展開して足す(仮想関数を通らないので、各項はインライン化される)
+//各項のcost()はゲインを掛けた値を返す(ゲインが0の項は計算しない)
+//deferredな項は高いので、他の項で足切りしてから最後に計算する(lower_bound()はその下限)
+template<>
+struct Cost_pipeline<>{
+	static const int size = 0;
+	template<typename Context, typename Sample>
+	static double eager(const Context&, const Sample&){ return 0.0; }
+	template<typename Context, typename Sample>
+	static double deferred(const Context&, const Sample&){ return 0.0; }
+	template<typename Context>
+	static double deferred_lower_bound(const Context&){ return 0.0; }
+	template<typename Context, typename Sample>
+	static void breakdown(const Context&, const Sample&, double*){}
+	static void names(const char**){}
+};
+
+template<typename Term, typename... Rest>
+struct Cost_pipeline<Term, Rest...>{
+	typedef Cost_pipeline<Rest...> Next;
+	static const int size = 1 + Next::size;
+
+	//全部の項の和(足切りしてから足したときと同じ値になるように、安い項の和に後から足す)
+	template<typename Context, typename Sample>
+	static double cost(const Context& ctx, const Sample& s)
+	{
+		return eager(ctx, s) + deferred(ctx, s);
+	}
+	//deferredでない項の和
+	template<typename Context, typename Sample>
+	static double eager(const Context& ctx, const Sample& s)
+	{
+		return (Term::deferred ? 0.0 : Term::cost(ctx, s)) + Next::eager(ctx, s);
+	}
+	//deferredな項の和
+	template<typename Context, typename Sample>
+	static double deferred(const Context& ctx, const Sample& s)
+	{
+		return (Term::deferred ? Term::cost(ctx, s) : 0.0) + Next::deferred(ctx, s);
+	}
+	template<typename Context>
+	static double deferred_lower_bound(const Context& ctx)
+	{
+		return (Term::deferred ? Term::lower_bound(ctx) : 0.0) + Next::deferred_lower_bound(ctx);
+	}
+	//項ごとの値(デバッグ用)
+	template<typename Context, typename Sample>
+	static void breakdown(const Context& ctx, const Sample& s, double* values)
+	{
+		values[0] = Term::cost(ctx, s);
+		Next::breakdown(ctx, s, values + 1);
+	}
+	static void names(const char** out)
+	{
+		out[0] = Term::name();
+		Next::names(out + 1);
+	}
+};
+
+struct Local_planner::Goal_term{
+	static const bool deferred = false;
+	static const char* name(void){ return "goal"; }
+	static double cost(const Tracking_context& ctx, const Rollout_sample& s)
+	{
+		return ctx.use_nav ? ctx.planner->calc_nav_cost(ctx, s.l_last) : ctx.planner->calc_to_g_goal_cost(ctx, s.l_last);
+	}
+	static double lower_bound(const Tracking_context&){ return 0.0; }
+};
+
+//終端がgpathからどれだけ横にずれているか
+struct Local_planner::Path_term{
+	static const bool deferred = false;
+	static const char* name(void){ return "path"; }
+	static double cost(const Tracking_context& ctx, const Rollout_sample& s)
+	{
+		const double gain = ctx.planner->params.path_cost_gain;
+		if(gain == 0.0) return 0.0;
+		double x = 0.0;
+		double y = 0.0;
+		ctx.planner->to_global(ctx, s.l_last, x, y);
+		const Position& p = ctx.g_path_point;
+		return gain*std::fabs((y - p.y)*std::cos(p.yaw) - (x - p.x)*std::sin(p.yaw));
+	}
+	static double lower_bound(const Tracking_context&){ return 0.0; }
+};
+
+//終端の向きと、終端から目標点への向きの差
+struct Local_planner::Heading_term{
+	static const bool deferred = false;
+	static const char* name(void){ return "heading"; }
+	static double cost(const Tracking_context& ctx, const Rollout_sample& s)
+	{
+		const double gain = ctx.planner->params.heading_cost_gain;
+		if(gain == 0.0) return 0.0;
+		double x = 0.0;
+		double y = 0.0;
+		ctx.planner->to_global(ctx, s.l_last, x, y);
+		double diff = atan(ctx.g_goal.x - x, ctx.g_goal.y - y) - ctx.g_roomba.yaw - s.l_last.yaw;
+		return gain*std::fabs(std::atan2(std::sin(diff), std::cos(diff)));
+	}
+	static double lower_bound(const Tracking_context&){ return 0.0; }
+};
+
+//遅いほど大きい
+struct Local_planner::Speed_term{
+	static const bool deferred = false;
+	static const char* name(void){ return "speed"; }
+	static double cost(const Tracking_context& ctx, const Rollout_sample& s)
+	{
+		const Local_planner_params& p = ctx.planner->params;
+		if(p.speed_cost_gain == 0.0) return 0.0;
+		return p.speed_cost_gain*(p.limit_speed - s.v);
+	}
+	static double lower_bound(const Tracking_context&){ return 0.0; }
+};
+
+//今の速度から変えるのにかかる時間[s]
+struct Local_planner::Smoothness_term{
+	static const bool deferred = false;
+	static const char* name(void){ return "smoothness"; }
+	static double cost(const Tracking_context& ctx, const Rollout_sample& s)
+	{
+		const Local_planner_params& p = ctx.planner->params;
+		if(p.smoothness_cost_gain == 0.0) return 0.0;
+		return p.smoothness_cost_gain*(std::fabs(s.v - ctx.g_roomba.v)/p.max_accel
+				+ std::fabs(s.omega - ctx.g_roomba.omega)/p.max_dyawrate);
+	}
+	static double lower_bound(const Tracking_context&){ return 0.0; }
+};
+
+//障害物に近いほど大きい(当たるならinf)
+struct Local_planner::Clearance_term{
+	static const bool deferred = true;
+	static const char* name(void){ return "clearance"; }
+	static double cost(const Tracking_context& ctx, const Rollout_sample& s)
+	{
+		const Local_planner& planner = *ctx.planner;
+		if(planner.arc_clearance) return planner.calc_arc_ob_cost(s.v, s.omega);
+		if(s.traj) return planner.calc_l_ob_cost(s.traj, s.traj_size);
+		if(s.min_dist <= planner.params.roomba_radius) return std::numeric_limits<double>::infinity();
+		return planner.params.l_ob_cost_gain/s.min_dist;
+	}
+	//障害物までの距離はmax_distで打ち切っているので、これ以上
+	static double lower_bound(const Tracking_context& ctx)
+	{
+		return ctx.planner->params.l_ob_cost_gain/ctx.planner->ob_grid.max_dist;
+	}
+};
+
+void Local_planner::Rollout_batch::evaluate(const Tracking_context& ctx, int steps)
+{
+	const Local_planner& planner = *ctx.planner;
+	const Ob_grid& ob_grid = planner.ob_grid;
+	const double dt = planner.params.dt;
+	double x[LANES];
+	double y[LANES];
+	double c[LANES];
+	double s[LANES];
+	double cr[LANES];
+	double sr[LANES];
+	double step[LANES];
+	double min_dist[LANES];
+	const double start_dist = ob_grid.clearance(0.0, 0.0);
+	const bool arc = planner.arc_clearance;
+	int t = 0;
+
+	//各ステップのcos/sinは回転の漸化式(yawをomega*dtずつ回す)で更新するので、三角関数は候補ごとに1回だけ
+	for(int l = 0; l < LANES; l++){
+		//余ったレーンは停止で埋めて、結果は使わない
+		double l_v = l < size ? v[l] : 0.0;
+		double l_omega = l < size ? omega[l] : 0.0;
+		x[l] = 0.0;
+		y[l] = 0.0;
+		c[l] = 1.0;
+		s[l] = 0.0;
+		cr[l] = std::cos(l_omega*dt);
+		sr[l] = std::sin(l_omega*dt);
+		step[l] = l_v*dt;
+		min_dist[l] = start_dist;
+	}
+
+	while(t < steps){
+		t++;
+		for(int l = 0; l < LANES; l++){
+			double c_next = c[l]*cr[l] - s[l]*sr[l];
+			s[l] = s[l]*cr[l] + c[l]*sr[l];
+			c[l] = c_next;
+			x[l] += step[l]*c[l];
+			y[l] += step[l]*s[l];
+		}
+		if(arc) continue;
+		int collided = 0;
+		for(int l = 0; l < LANES; l++){
+			min_dist[l] = std::min(min_dist[l], ob_grid.clearance(x[l], y[l]));
+			collided += min_dist[l] <= planner.params.roomba_radius;
+		}
+		//全レーンが衝突したら、それ以上積分しても評価は変わらない
+		if(collided == LANES) break;
+	}
+
+	for(int l = 0; l < size; l++){
+		Rollout_sample r;
+		r.v = v[l];
+		r.omega = omega[l];
+		r.l_last.x = x[l];
+		r.l_last.y = y[l];
+		r.l_last.yaw = omega[l]*dt*t;
+		r.l_last.v = v[l];
+		r.l_last.omega = omega[l];
+		r.traj = NULL;
+		r.traj_size = 0;
+		r.min_dist = min_dist[l];
+		cost[l] = Dwa_cost::cost(ctx, r);
+	}
+	return;
+}
+
+void Local_planner::Mppi::init(const Local_planner_params& p)
+{
+	samples = std::max(p.mppi_samples, 1);
+	horizon = int(p.predict_time/p.dt);
+	lambda = p.mppi_lambda;
+	sigma_v = p.mppi_sigma_v;
+	sigma_omega = p.mppi_sigma_omega;
+	u_v.assign(horizon, 0.0);
+	u_omega.assign(horizon, 0.0);
+	eps_v.resize(horizon*samples);
+	eps_omega.resize(horizon*samples);
+	x.resize(samples);
+	y.resize(samples);
+	yaw.resize(samples);
+	min_dist.resize(samples);
+	cost.resize(samples);
+	rng.seed(0);
+	return;
+}
+
+int Local_planner::Mppi::get_samples(void) const
+{
+	return samples;
+}
+
+//時間とともに変わる(v, omega)の列をsamples本ばらつかせ、motion()と同じモデルで全サンプルを1ステップずつまとめて積分する
+//コストの指数重みでばらつきを平均して制御列を更新し、先頭を出力する
+//次の周期は解を1ステップずらしたものから始める
+Speed Local_planner::Mppi::control(Local_planner& planner, const Tracking_context& ctx)
+{
+	const Local_planner_params& p = planner.params;
+	const Ob_grid& ob_grid = planner.ob_grid;
+	const double dt = p.dt;
+	const double inf = std::numeric_limits<double>::infinity();
+	//衝突するサンプルのコスト(dwa_controlで選ばないコストと同じ)
+	const double collision_cost = MAX_COST;
+	std::normal_distribution<double> normal(0.0, 1.0);
+	Speed output = {0.0, 0.0};
+
+	if(horizon <= 0) return output;
+
+	//前周期の解を1ステップずらす(最後は同じ値を続ける)
+	if(horizon > 1){
+		std::rotate(u_v.begin(), u_v.begin() + 1, u_v.end());
+		std::rotate(u_omega.begin(), u_omega.begin() + 1, u_omega.end());
+		u_v[horizon - 1] = u_v[horizon - 2];
+		u_omega[horizon - 1] = u_omega[horizon - 2];
+	}
+
+	//制御列にノイズを加え、速度と加速度の制限で切った後の差をノイズとして使う
+	for(int i = 0; i < samples; i++){
+		double prev_v = ctx.g_roomba.v;
+		double prev_omega = ctx.g_roomba.omega;
+		for(int k = 0; k < horizon; k++){
+			double v = u_v[k] + sigma_v*normal(rng);
+			double omega = u_omega[k] + sigma_omega*normal(rng);
+			v = std::min(std::max(v, prev_v - p.max_accel*dt), prev_v + p.max_accel*dt);
+			v = std::min(std::max(v, p.min_speed), p.limit_speed);
+			omega = std::min(std::max(omega, prev_omega - p.max_dyawrate*dt), prev_omega + p.max_dyawrate*dt);
+			omega = std::min(std::max(omega, -p.limit_yawrate), p.limit_yawrate);
+			eps_v[k*samples + i] = v - u_v[k];
+			eps_omega[k*samples + i] = omega - u_omega[k];
+			prev_v = v;
+			prev_omega = omega;
+		}
+	}
+
+	//全サンプルを同時に積分する(local)
+	std::fill(x.begin(), x.end(), 0.0);
+	std::fill(y.begin(), y.end(), 0.0);
+	std::fill(yaw.begin(), yaw.end(), 0.0);
+	std::fill(min_dist.begin(), min_dist.end(), ob_grid.clearance(0.0, 0.0));
+	std::fill(cost.begin(), cost.end(), 0.0);
+	for(int k = 0; k < horizon; k++){
+		const double* e_v = &eps_v[k*samples];
+		const double* e_omega = &eps_omega[k*samples];
+		for(int i = 0; i < samples; i++){
+			double v = u_v[k] + e_v[i];
+			yaw[i] += (u_omega[k] + e_omega[i])*dt;
+			x[i] += v*std::cos(yaw[i])*dt;
+			y[i] += v*std::sin(yaw[i])*dt;
+		}
+		for(int i = 0; i < samples; i++){
+			min_dist[i] = std::min(min_dist[i], ob_grid.clearance(x[i], y[i]));
+		}
+	}
+
+	//終端の目標点のコストと障害物のコストはdwa_controlと同じ
+	//(ノイズの制御コスト項は速度・加速度で切ったノイズだと前進を妨げるので入れない)
+	double min_cost = inf;
+	for(int i = 0; i < samples; i++){
+		Status l_last = {x[i], y[i], yaw[i], 0.0, 0.0};
+		double to_g_path_cost = ctx.use_nav ? planner.calc_nav_cost(ctx, l_last) : planner.calc_to_g_goal_cost(ctx, l_last);
+		double l_ob_cost = min_dist[i] <= p.roomba_radius ? collision_cost : p.l_ob_cost_gain/min_dist[i];
+		cost[i] += std::min(to_g_path_cost + l_ob_cost, collision_cost);
+		min_cost = std::min(min_cost, cost[i]);
+	}
+
+	double total_weight = 0.0;
+	for(int i = 0; i < samples; i++){
+		cost[i] = std::exp(-(cost[i] - min_cost)/lambda);
+		total_weight += cost[i];
+	}
+	for(int k = 0; k < horizon; k++){
+		double d_v = 0.0;
+		double d_omega = 0.0;
+		for(int i = 0; i < samples; i++){
+			d_v += cost[i]*eps_v[k*samples + i];
+			d_omega += cost[i]*eps_omega[k*samples + i];
+		}
+		u_v[k] += d_v/total_weight;
+		u_omega[k] += d_omega/total_weight;
+	}
+
+	//更新した制御列の軌道をlpathにする(障害物に当たるなら止まって解を捨てる)
+	std::vector<Status> l_traj;
+	Status roomba = {0.0, 0.0, 0.0, 0.0, 0.0};
+	double nominal_dist = ob_grid.clearance(0.0, 0.0);
+	l_traj.push_back(roomba);
+	for(int k = 0; k < horizon; k++){
+		motion(roomba, u_v[k], u_omega[k], dt);
+		l_traj.push_back(roomba);
+		nominal_dist = std::min(nominal_dist, ob_grid.clearance(roomba.x, roomba.y));
+	}
+	planner.log_best_traj(&l_traj[0], l_traj.size());
+	if(nominal_dist <= p.roomba_radius){
+		std::fill(u_v.begin(), u_v.end(), 0.0);
+		std::fill(u_omega.begin(), u_omega.end(), 0.0);
+		return output;
+	}
+
+	output.v = u_v[0];
+	output.omega = u_omega[0];
+	return output;
+}
+
+Local_planner::Local_planner(void)
+{
+	nav_function.resolution = 0.0;
+	nav_function.origin_x = 0.0;
+	nav_function.origin_y = 0.0;
+	nav_function.width = 0;
+	nav_function.height = 0;
+	g_path_cursor = 0;
+	can_goal = false;
+	g_goal.x = g_goal.y = g_goal.yaw = 0.0;
+	prev_output.v = prev_output.omega = 0.0;
+	has_prev_output = false;
+	samples = 0;
+	pruned = 0;
+	batch_rollout = false;
+	arc_clearance = false;
+}
+
+void Local_planner::init(const Local_planner_params& p)
+{
+	params = p;
+	batch_rollout = params.rollout_mode == "batch";
+	arc_clearance = params.clearance_mode == "arc";
+	traj_library.build(params, !batch_rollout);
+	scan_filter.init(params.scan_filter);
+	ob_grid.init(params.ob_grid_resolution, params.limit_speed*params.predict_time, params.ob_dist_max);
+	mppi.init(params);
+	worker_pool.start(std::max(params.num_threads, 1));
+	g_path_cursor = 0;
+	can_goal = false;
+	has_prev_output = false;
+	return;
+}
+
+void Local_planner::set_path(const std::vector<Position>& path)
+{
+	g_path = path;
+	g_path_cursor = 0;
+	return;
+}
+
+void Local_planner::set_nav_function(const Nav_grid& grid)
+{
+	nav_function = grid;
+	return;
+}
+
+void Local_planner::reset_goal(void)
+{
+	can_goal = false;
+	return;
+}
+
+bool Local_planner::get_can_goal(void) const
+{
+	return can_goal;
+}
+
+Position Local_planner::get_target(void) const
+{
+	return g_goal;
+}
+
+const std::vector<Status>& Local_planner::get_best_traj(void) const
+{
+	return best_traj;
+}
+
+int Local_planner::get_samples(void) const
+{
+	return samples;
+}
+
+int Local_planner::get_pruned(void) const
+{
+	return pruned;
+}
+
+const Local_planner_params& Local_planner::get_params(void) const
+{
+	return params;
+}
+
+const Traj_library& Local_planner::get_traj_library(void) const
+{
+	return traj_library;
+}
+
+void Local_planner::log_best_traj(const Status* l_traj, int traj_size)
+{
+	best_traj.assign(l_traj, l_traj + traj_size);
+	return;
+}
+
+//local(base_link)の点をglobalに直す
+void Local_planner::to_global(const Tracking_context& ctx, const Status& l_point, double& x, double& y) const
+{
+	x = ctx.g_roomba.x + l_point.x*ctx.c - l_point.y*ctx.s;
+	y = ctx.g_roomba.y + l_point.x*ctx.s + l_point.y*ctx.c;
+	return;
+}
+
+double Local_planner::calc_to_g_goal_cost(const Tracking_context& ctx, const Status& l_last) const
+{
+	double x = 0.0;
+	double y = 0.0;
+
+	to_global(ctx, l_last, x, y);
+
+	return params.to_g_goal_cost_gain*calc_dist(ctx.g_goal.x, x, ctx.g_goal.y, y);
+}
+
+//gpath上の追従する目標点を求める(can_goalもここで更新する)
+Position Local_planner::find_g_path_target(const Status& g_roomba)
+{
+	const int search_back = 5;
+	const int search_forward = 20;
+	const double reacquire_dist = 1.0;
+	int n_g_path_p_d_i = 0;//nearest gpath point distance i
+	int next_g_path_p_i = 0;
+	double n_g_path_p_d = 10000.0;//nearest gpath point distance
+	double g_error_dist = 0.0;
+	//スタートでg_path[0]が最も近い点となるように-10している
+	const int search_end = std::max((int)g_path.size() - 10, 1);
+
+	if(!can_goal){
+		int begin = std::max(std::min(g_path_cursor, search_end - 1) - search_back, 0);
+		int end = std::min(begin + search_back + search_forward, search_end);
+		for(int pass = 0; pass < 2; pass++){
+			for(int i = begin; i < end; i++){
+				g_error_dist = calc_dist(g_path[i].x, g_roomba.x, g_path[i].y, g_roomba.y);
+
+				if(n_g_path_p_d > g_error_dist){
+					n_g_path_p_d = g_error_dist;
+					n_g_path_p_d_i = i;
+				}
+			}
+			if(n_g_path_p_d <= reacquire_dist || (begin == 0 && end == search_end)) break;
+			begin = 0;
+			end = search_end;
+		}
+		g_path_cursor = n_g_path_p_d_i;
+		next_g_path_p_i = n_g_path_p_d_i + 2;
+		if(next_g_path_p_i >= search_end){
+			can_goal = true;
+			next_g_path_p_i = g_path.size() - 1;
+		}
+	} else {
+		next_g_path_p_i = g_path.size() - 1;
+	}
+
+	return g_path[next_g_path_p_i];
+}
+
+//a_starが配信するコスト場から(x, y)のgoalまでのコストを引く(範囲外はinf)
+double Local_planner::nav_function_value(double x, double y) const
+{
+	const double inf = std::numeric_limits<double>::infinity();
+
+	if(nav_function.data.empty() || nav_function.resolution <= 0.0) return inf;
+
+	int ix = std::floor((x - nav_function.origin_x)/nav_function.resolution);
+	int iy = std::floor((y - nav_function.origin_y)/nav_function.resolution);
+	if(ix < 0 || ix >= nav_function.width || iy < 0 || iy >= nav_function.height) return inf;
+
+	return nav_function.data[ix + nav_function.width*iy];
+}
+
+//軌道の終端(global)のコスト場の値
+double Local_planner::calc_nav_cost(const Tracking_context& ctx, const Status& l_last) const
+{
+	double x = 0.0;
+	double y = 0.0;
+
+	to_global(ctx, l_last, x, y);
+
+	return params.nav_cost_gain*nav_function_value(x, y);
+}
+
+void Local_planner::build_tracking_context(Tracking_context& ctx, const Status& g_roomba)
+{
+	ctx.planner = this;
+	ctx.g_roomba = g_roomba;
+	ctx.s = std::sin(g_roomba.yaw);
+	ctx.c = std::cos(g_roomba.yaw);
+	ctx.g_goal = g_goal = find_g_path_target(g_roomba);
+	const Position& p = g_path[std::min(g_path_cursor, (int)g_path.size() - 1)];
+	ctx.g_path_point.x = p.x;
+	ctx.g_path_point.y = p.y;
+	ctx.g_path_point.yaw = atan(ctx.g_goal.x - p.x, ctx.g_goal.y - p.y);
+	if(calc_dist(ctx.g_goal.x, p.x, ctx.g_goal.y, p.y) <= EPS) ctx.g_path_point.yaw = g_roomba.yaw;
+	//現在位置がコスト場の範囲内ならgpathの目標点の代わりにコスト場を引く
+	ctx.use_nav = params.use_nav_function && std::isfinite(nav_function_value(g_roomba.x, g_roomba.y));
+	return;
+}
+
+//全部local
+double Local_planner::calc_l_ob_cost(const Status* traj, int traj_size) const
+{
+	const double inf = std::numeric_limits<double>::infinity();
+	double dist = 0.0;
+	double min_dist = inf;
+
+	for(int i = 0; i < traj_size; i++){
+		dist = ob_grid.clearance(traj[i].x, traj[i].y);
+
+		if(dist <= params.roomba_radius) return inf;
+
+		if(min_dist > dist) min_dist = dist;
+	}
+
+	return params.l_ob_cost_gain/min_dist;
+}
+
+//一定の(v, omega)で原点から向き0で出る軌道は円弧(omega=0なら線分)なので、
+//scan点までの距離を解析的に求める(dtによらず厳密、max_distで打ち切り)
+//円弧の中心は(0, v/omega)、出発点から進む向きに測った中心角がspan以内なら点は円弧の真横にある
+//全点は見ずに、距離場から求めた上界だけ円弧の外接矩形を広げた範囲のbucketの点だけを調べる
+double Local_planner::calc_arc_clearance(double v, double omega, double time) const
+{
+	const bool line = std::fabs(omega) <= EPS;
+	const double r = line ? 0.0 : v/omega;
+	const double r_abs = std::fabs(r);
+	const double span = std::fabs(omega)*time;
+	const double sign = omega > 0.0 ? 1.0 : -1.0;
+	const double length = v*time;
+	const double end_x = line ? length : r*std::sin(omega*time);
+	const double end_y = line ? 0.0 : r*(1.0 - std::cos(omega*time));
+	const double cos_span = std::cos(span);
+	const double sin_span = std::sin(span);
+	double min_dist = ob_grid.max_dist;
+
+	//円弧上の点のセルが持つ最近点までの距離は、セルの値+セルの大きさ以下
+	//円弧上の点は弦の向きを回転の漸化式で回しながら弦の長さずつ進めて求める
+	const int n = std::max(int(std::ceil(std::fabs(length)/ob_grid.resolution)), 1);
+	const double step = line ? length/n : 2*r*std::sin(0.5*omega*time/n);
+	const double cr = std::cos(omega*time/n);
+	const double sr = std::sin(omega*time/n);
+	double x = 0.0;
+	double y = 0.0;
+	double c = std::cos(0.5*omega*time/n);
+	double s = std::sin(0.5*omega*time/n);
+	for(int k = 0; k <= n; k++){
+		double d = ob_grid.clearance(x, y);
+		if(d < ob_grid.max_dist) min_dist = std::min(min_dist, d + ob_grid.resolution);
+		x += step*c;
+		y += step*s;
+		double c_next = c*cr - s*sr;
+		s = s*cr + c*sr;
+		c = c_next;
+	}
+
+	//円弧の外接矩形(中心角がpi/2, pi, 3pi/2を通るなら円の端まで広がる)
+	double x_min = std::min(0.0, end_x);
+	double x_max = std::max(0.0, end_x);
+	double y_min = std::min(0.0, end_y);
+	double y_max = std::max(0.0, end_y);
+	if(!line){
+		if(span >= 0.5*M_PI) x_max = r_abs;
+		if(span >= 1.5*M_PI) x_min = -r_abs;
+		if(span >= M_PI){
+			y_min = std::min(0.0, 2*r);
+			y_max = std::max(0.0, 2*r);
+		}
+	}
+
+	const int bx_min = ob_grid.bucket_index(x_min - min_dist);
+	const int bx_max = ob_grid.bucket_index(x_max + min_dist);
+	const int by_min = ob_grid.bucket_index(y_min - min_dist);
+	const int by_max = ob_grid.bucket_index(y_max + min_dist);
+	const std::vector<Position>& points = ob_grid.bucket_points;
+
+	for(int by = by_min; by <= by_max; by++){
+		const double gy = std::max(std::max(ob_grid.origin + by*ob_grid.bucket_size - y_max,
+					y_min - ob_grid.origin - (by + 1)*ob_grid.bucket_size), 0.0);
+		for(int bx = bx_min; bx <= bx_max; bx++){
+			//bucketから外接矩形までの距離が今の最小以上なら、中の点も円弧までそれ以上離れている
+			const double gx = std::max(std::max(ob_grid.origin + bx*ob_grid.bucket_size - x_max,
+						x_min - ob_grid.origin - (bx + 1)*ob_grid.bucket_size), 0.0);
+			if(gx*gx + gy*gy >= min_dist*min_dist) continue;
+
+			const int b = bx + ob_grid.bucket_count*by;
+			for(int i = ob_grid.bucket_start[b]; i < ob_grid.bucket_start[b + 1]; i++){
+				if(line){
+					double t = std::min(std::max(points[i].x, std::min(0.0, length)), std::max(0.0, length));
+					min_dist = std::min(min_dist, calc_dist(points[i].x, t, points[i].y, 0.0));
+					continue;
+				}
+
+				const double qx = points[i].x;
+				const double qy = points[i].y - r;
+				const double radial = std::fabs(std::sqrt(qx*qx + qy*qy) - r_abs);
+
+				//円弧までの距離は円までの距離以上なので、それで更新できない点は角度を求めない
+				if(radial >= min_dist) continue;
+
+				//中心から見た向き(出発点の向きから進む向きに測る)が0からspanの間にあるかを外積で調べる
+				const double px = -sign*qy;
+				const double py = qx;
+				const bool after_start = py >= 0.0;
+				const bool before_end = cos_span*py - sin_span*px <= 0.0;
+				if(span >= 2*M_PI || (span <= M_PI ? after_start && before_end : after_start || before_end)){
+					min_dist = radial;
+				} else {
+					min_dist = std::min(min_dist, std::min(calc_dist(points[i].x, 0.0, points[i].y, 0.0),
+								calc_dist(points[i].x, end_x, points[i].y, end_y)));
+				}
+			}
+		}
+	}
+
+	return min_dist;
+}
+
+double Local_planner::calc_arc_ob_cost(double v, double omega) const
+{
+	const double inf = std::numeric_limits<double>::infinity();
+	double min_dist = calc_arc_clearance(v, omega, (traj_library.traj_size - 1)*params.dt);
+
+	if(min_dist <= params.roomba_radius) return inf;
+
+	return params.l_ob_cost_gain/min_dist;
+}
+
+//libraryの(v_i, y_i)の軌道
+Local_planner::Rollout_sample Local_planner::library_sample(int v_i, int y_i) const
+{
+	Rollout_sample s;
+	s.v = traj_library.v(v_i);
+	s.omega = traj_library.omega(y_i);
+	s.traj = traj_library.get(v_i, y_i);
+	s.traj_size = traj_library.traj_size;
+	s.l_last = s.traj[s.traj_size - 1];
+	s.min_dist = 0.0;
+	return s;
+}
+
+//(v_i, y_i)の軌道の評価値
+double Local_planner::evaluate_sample(const Tracking_context& ctx, int v_i, int y_i) const
+{
+	return Dwa_cost::cost(ctx, library_sample(v_i, y_i));
+}
+
+//libraryがなければ(batch)1本だけのbatchとして評価する
+double Local_planner::evaluate_candidate(const Tracking_context& ctx, int v_i, int y_i) const
+{
+	if(!traj_library.points.empty()) return evaluate_sample(ctx, v_i, y_i);
+
+	Rollout_batch batch;
+	batch.size = 1;
+	batch.v[0] = traj_library.v(v_i);
+	batch.omega[0] = traj_library.omega(y_i);
+	batch.evaluate(ctx, traj_library.traj_size - 1);
+	return batch.cost[0];
+}
+
+//格子点を全部評価する
+//libraryのときは、各区間の安い項(deferredでない項)を先に全部求めて小さい順に障害物のコストを足していく
+//安い項に障害物のコストの下限を足してもその時点の最良を超えるなら、残りは評価しなくてよい
+//最初の上界には前周期に選んだ速度の評価値を使う
+Local_planner::Sample_result Local_planner::search_lattice(const Tracking_context& ctx, const Sample_window& window)
+{
+	const int n_samples = window.size();
+	const double min_ob_cost = Dwa_cost::deferred_lower_bound(ctx);
+	Sample_result seed = {MAX_COST, -1};
+
+	if(has_prev_output && !batch_rollout){
+		int a = int(std::floor((prev_output.v - params.min_speed)/params.dv + 0.5)) - window.min_v_i;
+		int b = int(std::floor(prev_output.omega/params.dyaw + 0.5)) + traj_library.omega_offset - window.min_omega_i;
+		if(a >= 0 && a < window.n_v && b >= 0 && b < window.n_omega){
+			seed.index = a*window.n_omega + b;
+			seed.cost = evaluate_sample(ctx, window.v_i(seed.index), window.y_i(seed.index));
+			samples++;
+			if(!(seed.cost < MAX_COST)) seed.index = -1;
+			seed.cost = std::min(seed.cost, MAX_COST);
+		}
+	}
+
+	//サンプルを通し番号で等分し、各区間の最小を求めてから番号の小さい順にまとめる
+	//(同じコストなら番号の小さい方を採るので、スレッド数によらず直列と同じ結果になる)
+	std::vector<Sample_result> results(worker_pool.size());
+	std::vector<int> pruned_counts(worker_pool.size(), 0);
+	std::function<void(int)> evaluate = [&](int id){
+		const int begin = (long)n_samples*id/results.size();
+		const int end = (long)n_samples*(id + 1)/results.size();
+		Sample_result best = {MAX_COST, -1};
+		if(batch_rollout){
+			Rollout_batch batch;
+			for(int i = begin; i < end; i += Rollout_batch::LANES){
+				batch.size = std::min(end - i, (int)Rollout_batch::LANES);
+				for(int l = 0; l < batch.size; l++){
+					batch.v[l] = traj_library.v(window.v_i(i + l));
+					batch.omega[l] = traj_library.omega(window.y_i(i + l));
+				}
+				batch.evaluate(ctx, traj_library.traj_size - 1);
+				for(int l = 0; l < batch.size; l++){
+					if(best.cost > batch.cost[l]){
+						best.cost = batch.cost[l];
+						best.index = i + l;
+					}
+				}
+			}
+		} else {
+			std::vector<Sample_result> order;
+			order.reserve(end - begin);
+			for(int i = begin; i < end; i++){
+				Sample_result r = {Dwa_cost::eager(ctx, library_sample(window.v_i(i), window.y_i(i))), i};
+				order.push_back(r);
+			}
+			std::sort(order.begin(), order.end(), is_better<Sample_result>);
+
+			best = seed;
+			for(int k = 0; k < order.size(); k++){
+				Sample_result lower_bound = {order[k].cost + min_ob_cost, order[k].index};
+				if(!is_better(lower_bound, best)){
+					pruned_counts[id] = order.size() - k;
+					break;
+				}
+				Sample_result r = {order[k].cost + Dwa_cost::deferred(ctx, library_sample(window.v_i(order[k].index), window.y_i(order[k].index))), order[k].index};
+				if(is_better(r, best)) best = r;
+			}
+		}
+		results[id] = best;
+	};
+	if(results.size() > 1 && n_samples >= results.size()) worker_pool.run(evaluate);
+	else{
+		results.resize(1);
+		evaluate(0);
+	}
+	for(int i = 0; i < results.size(); i++){
+		pruned += pruned_counts[i];
+	}
+	samples += n_samples - pruned;
+
+	Sample_result best = {MAX_COST, -1};
+	for(int i = 0; i < results.size(); i++){
+		if(results[i].index >= 0 && is_better(results[i], best)) best = results[i];
+	}
+	return best;
+}
+
+//粗い格子を評価してから、良い順にrefine_candidates個の周りを間隔を半分にして評価していく
+//deadlineを過ぎたらその時点の最良を返す(粗い格子だけは必ず評価する)
+Local_planner::Sample_result Local_planner::search_adaptive(const Tracking_context& ctx, const Sample_window& window,
+		std::chrono::steady_clock::time_point deadline)
+{
+	const int refine_candidates = 3;
+	const int coarse_points = 4;
+	std::vector<bool> evaluated(window.size(), false);
+	std::vector<Sample_result> done;
+	Sample_result best = {MAX_COST, -1};
+	int stride = 1;
+
+	auto evaluate = [&](const int a, const int b){
+		if(a < 0 || a >= window.n_v || b < 0 || b >= window.n_omega) return;
+		const int index = a*window.n_omega + b;
+		if(evaluated[index]) return;
+		evaluated[index] = true;
+		Sample_result r = {evaluate_candidate(ctx, window.v_i(index), window.y_i(index)), index};
+		done.push_back(r);
+		samples++;
+		if(is_better(r, best)) best = r;
+	};
+	while(stride*coarse_points < std::max(window.n_v, window.n_omega)) stride *= 2;
+	for(int a = 0; a < window.n_v + stride - 1; a += stride){
+		for(int b = 0; b < window.n_omega + stride - 1; b += stride){
+			//端の格子点も評価する
+			evaluate(std::min(a, window.n_v - 1), std::min(b, window.n_omega - 1));
+		}
+	}
+
+	while(stride > 1 && std::chrono::steady_clock::now() < deadline){
+		stride /= 2;
+		const int n = std::min((int)done.size(), refine_candidates);
+		std::partial_sort(done.begin(), done.begin() + n, done.end(), is_better<Sample_result>);
+		std::vector<Sample_result> centers(done.begin(), done.begin() + n);
+		for(int c = 0; c < centers.size(); c++){
+			const int a = centers[c].index/window.n_omega;
+			const int b = centers[c].index%window.n_omega;
+			for(int da = -stride; da <= stride; da += stride){
+				for(int db = -stride; db <= stride; db += stride){
+					if(std::chrono::steady_clock::now() >= deadline) return best;
+					evaluate(a + da, b + db);
+				}
+			}
+		}
+	}
+
+	return best;
+}
+
+//選んだ軌道の評価値の内訳を表示する
+void Local_planner::print_cost(const Tracking_context& ctx, const Rollout_sample& s) const
+{
+	double values[Dwa_cost::size];
+	const char* names[Dwa_cost::size];
+	std::ostringstream out;
+
+	Dwa_cost::breakdown(ctx, s, values);
+	Dwa_cost::names(names);
+	out << "v = " << s.v << " omega = " << s.omega << " cost = " << Dwa_cost::cost(ctx, s);
+	for(int i = 0; i < Dwa_cost::size; i++) out << " " << names[i] << " = " << values[i];
+	std::cout << out.str() << std::endl;
+	return;
+}
+
+Speed Local_planner::dwa_control(const Tracking_context& ctx)
+{
+	Dw dw = {0.0, 0.0, 0.0, 0.0};
+	Speed best_output = {0.0, 0.0};
+	Sample_result best = {MAX_COST, -1};
+	const std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now()
+		+ std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(params.time_budget));
+
+	//dynamic windowの計算
+	calc_dynamic_window(dw, ctx.g_roomba, params);
+
+	//dynamic windowに含まれる格子点の範囲
+	Sample_window window;
+	window.min_v_i = std::max(int(std::ceil((dw.min_v - params.min_speed)/params.dv - EPS)), 0);
+	window.min_omega_i = std::max(int(std::ceil(dw.min_omega/params.dyaw - EPS)) + traj_library.omega_offset, 0);
+	window.n_v = std::max(std::min(int(std::floor((dw.max_v - params.min_speed)/params.dv + EPS)), traj_library.v_size - 1) - window.min_v_i + 1, 0);
+	window.n_omega = std::max(std::min(int(std::floor(dw.max_omega/params.dyaw + EPS)) + traj_library.omega_offset, traj_library.omega_size - 1) - window.min_omega_i + 1, 0);
+	if(!window.size()) return best_output;
+
+	if(params.sampling_mode == "adaptive") best = search_adaptive(ctx, window, deadline);
+	else best = search_lattice(ctx, window);
+	has_prev_output = best.index >= 0;
+
+	if(best.index >= 0){
+		int v_i = window.v_i(best.index);
+		int y_i = window.y_i(best.index);
+		best_output.v = traj_library.v(v_i);
+		best_output.omega = traj_library.omega(y_i);
+		prev_output = best_output;
+		//lpathは選んだ軌道だけから作る
+		std::vector<Status> l_traj;
+		Rollout_sample s;
+		if(traj_library.points.empty()){
+			calc_l_traj(l_traj, best_output.v, best_output.omega, params);
+			s.v = best_output.v;
+			s.omega = best_output.omega;
+			s.traj = &l_traj[0];
+			s.traj_size = l_traj.size();
+			s.l_last = l_traj.back();
+			s.min_dist = 0.0;
+		} else {
+			s = library_sample(v_i, y_i);
+		}
+		log_best_traj(s.traj, s.traj_size);
+		if(params.print_cost_breakdown) print_cost(ctx, s);
+	}
+
+	return best_output;
+}
+
+Speed Local_planner::control(const Status& g_roomba, const Scan& scan)
+{
+	Speed output = {0.0, 0.0};
+	Tracking_context ctx;
+
+	samples = 0;
+	pruned = 0;
+	scan_filter.apply(scan, filtered_scan);
+	ob_grid.update(filtered_scan);
+	if(arc_clearance) ob_grid.sort_buckets();
+	if(g_path.empty()) return output;
+
+	build_tracking_context(ctx, g_roomba);
+	if(params.controller == "mppi"){
+		samples = mppi.get_samples();
+		return mppi.control(*this, ctx);
+	}
+	return dwa_control(ctx);
+}
+
+void write_replay_path(std::ostream& out, const std::vector<Position>& path)
+{
+	std::ostringstream line;
+
+	line.precision(17);
+	line << "path " << path.size();
+	for(int i = 0; i < path.size(); i++) line << " " << path[i].x << " " << path[i].y << " " << path[i].yaw;
+	out << line.str() << "\n";
+	return;
+}
+
+void write_replay_reset_goal(std::ostream& out)
+{
+	out << "reset_goal\n";
+	return;
+}
+
+void write_replay_cycle(std::ostream& out, const Status& roomba, const Scan& scan)
+{
+	std::ostringstream line;
+
+	line.precision(17);
+	line << "cycle " << roomba.x << " " << roomba.y << " " << roomba.yaw << " " << roomba.v << " " << roomba.omega
+		<< " " << scan.angle_min << " " << scan.angle_increment << " " << scan.range_min << " " << scan.range_max
+		<< " " << scan.ranges.size();
+	line.precision(9);
+	for(int i = 0; i < scan.ranges.size(); i++) line << " " << scan.ranges[i];
+	out << line.str() << "\n";
+	return;
+}
+
+bool read_replay_frame(std::istream& in, Replay_frame& frame)
+{
+	std::string line;
+
+	frame.new_path = false;
+	frame.reset_goal = false;
+	while(std::getline(in, line)){
+		std::istringstream fields(line);
+		std::string kind;
+		int n = 0;
+		fields >> kind;
+		if(kind == "path"){
+			fields >> n;
+			frame.path.resize(std::max(n, 0));
+			for(int i = 0; i < frame.path.size(); i++) fields >> frame.path[i].x >> frame.path[i].y >> frame.path[i].yaw;
+			if(!fields) return false;
+			frame.new_path = true;
+		} else if(kind == "reset_goal"){
+			frame.reset_goal = true;
+		} else if(kind == "cycle"){
+			Status& r = frame.roomba;
+			Scan& s = frame.scan;
+			fields >> r.x >> r.y >> r.yaw >> r.v >> r.omega >> s.angle_min >> s.angle_increment >> s.range_min >> s.range_max >> n;
+			s.ranges.resize(std::max(n, 0));
+			for(int i = 0; i < s.ranges.size(); i++) fields >> s.ranges[i];
+			return !fields.fail();
+		}
+	}
+	return false;
+}
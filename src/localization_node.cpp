@@ -0,0 +1,13 @@
+#include "chibi19_a/localization_node.h"
+
+int main(int argc, char** argv)
+{
+	ros::init(argc, argv, "localization");
+	ros::NodeHandle nh_;
+	ros::NodeHandle private_nh_("~");
+
+	Localization localization(nh_, private_nh_);
+	ros::spin();
+
+	return 0;
+}
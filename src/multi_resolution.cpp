@@ -0,0 +1,90 @@
+#include "chibi19_a/multi_resolution.h"
+#include <algorithm>
+
+Multi_resolution_planner::Multi_resolution_planner(void)
+	: coarse_search(Manhattan_heuristic()), full_search(Manhattan_heuristic()), corridor_search(Manhattan_heuristic())
+{
+	grid = NULL;
+	expansions = 0;
+	//粗い格子のgoalのセルは障害物とまとめられていても到達を認める
+	coarse_search.set_goal_passable(true);
+}
+
+//levels[0]が1/2, levels[1]が1/4, ...の解像度
+void Multi_resolution_planner::build(const std::vector<std::vector<char> >& map_grid, int num_levels)
+{
+	grid = &map_grid;
+	levels.clear();
+	levels.reserve(num_levels);
+
+	const std::vector<std::vector<char> >* fine = &map_grid;
+	for(int l = 0; l < num_levels; l++){
+		int row = fine->size();
+		int col = row ? (*fine)[0].size() : 0;
+		if(row < 2 || col < 2)
+			break;
+
+		std::vector<std::vector<char> > coarse((row + 1) / 2, std::vector<char>((col + 1) / 2, -1));
+		for(int x = 0; x < row; x++){
+			for(int y = 0; y < col; y++){
+				char& c = coarse[x / 2][y / 2];
+				c = std::max(c, (*fine)[x][y]);
+			}
+		}
+		levels.push_back(coarse);
+		fine = &levels.back();
+	}
+}
+
+int Multi_resolution_planner::get_levels(void) const
+{
+	return levels.size();
+}
+
+bool Multi_resolution_planner::search(Cell start, Cell goal, int corridor, std::vector<Cell>& path)
+{
+	expansions = 0;
+	if(grid == NULL)
+		return false;
+
+	if(!levels.empty()){
+		int shift = levels.size();
+		const std::vector<std::vector<char> >& coarse = levels.back();
+		Cell c_start = {start.x >> shift, start.y >> shift};
+		Cell c_goal = {goal.x >> shift, goal.y >> shift};
+		std::vector<Cell> coarse_path;
+
+		bool found = coarse_search.search(coarse, c_start, c_goal, coarse_path);
+		expansions += coarse_search.get_expansions();
+		if(found){
+			//粗い経路をcorridorセルだけ膨らませた帯
+			int row = coarse.size();
+			int col = coarse[0].size();
+			mask.assign(row, std::vector<bool>(col, false));
+			for(int i = 0; i < coarse_path.size(); i++){
+				for(int x = std::max(0, coarse_path[i].x - corridor); x <= std::min(row - 1, coarse_path[i].x + corridor); x++){
+					for(int y = std::max(0, coarse_path[i].y - corridor); y <= std::min(col - 1, coarse_path[i].y + corridor); y++){
+						mask[x][y] = true;
+					}
+				}
+			}
+
+			Corridor_mask allowed = {&mask, shift};
+			corridor_search.set_mask(allowed);
+			found = corridor_search.search(*grid, start, goal, path);
+			expansions += corridor_search.get_expansions();
+			if(found)
+				return true;
+		}
+	}
+
+	//粗い格子で塞がる狭い通路などは元の解像度で全体を探索する
+	bool found = full_search.search(*grid, start, goal, path);
+	expansions += full_search.get_expansions();
+	return found;
+}
+
+int Multi_resolution_planner::get_expansions(void) const
+{
+	return expansions;
+}
@@ -0,0 +1,136 @@
+#include "chibi19_a/navigation_function.h"
+#include <cmath>
+#include <limits>
+#include <queue>
+#include <algorithm>
+
+namespace
+{
+const float INF = std::numeric_limits<float>::infinity();
+}
+
+Navigation_function::Navigation_function(void)
+{
+	min_x = 0;
+	min_y = 0;
+	width = 0;
+	height = 0;
+	bound = 0.0f;
+	goal.x = goal.y = 0;
+}
+
+//他の探索と同じく、セルへの進入コストは1+max(cost, 0)、障害物(100)は通れない
+void Navigation_function::compute(const std::vector<std::vector<char> >& grid, Cell g, Cell start, double margin)
+{
+	typedef std::pair<float, int> QueueEntry;
+	int row = grid.size();
+	int col = row ? grid[0].size() : 0;
+	std::vector<float> dist(row*col, INF);
+	std::priority_queue<QueueEntry, std::vector<QueueEntry>, std::greater<QueueEntry> > open;
+	float limit = INF;
+	int max_x = -1;
+	int max_y = -1;
+
+	goal = g;
+	field.clear();
+	min_x = row;
+	min_y = col;
+	width = 0;
+	height = 0;
+	bound = 0.0f;
+	if(goal.x < 0 || goal.x >= row || goal.y < 0 || goal.y >= col)
+		return;
+
+	int s_id = (start.x >= 0 && start.x < row && start.y >= 0 && start.y < col) ? start.x*col + start.y : -1;
+	dist[goal.x*col + goal.y] = 0.0f;
+	open.push(QueueEntry(0.0f, goal.x*col + goal.y));
+
+	while(!open.empty()){
+		QueueEntry top = open.top();
+		if(top.first > limit)
+			break;
+		open.pop();
+		if(top.first > dist[top.second])
+			continue;
+
+		bound = top.first;
+		if(top.second == s_id)
+			limit = top.first + margin;
+
+		int x = top.second / col;
+		int y = top.second % col;
+		//goalから逆向きにたどるので、辺(x2, y2)->(x, y)のコストは(x, y)への進入コスト
+		float enter = enter_cost(grid[x][y]);
+		min_x = std::min(min_x, x);
+		min_y = std::min(min_y, y);
+		max_x = std::max(max_x, x);
+		max_y = std::max(max_y, y);
+		for(int i = 0; i < 4; i++){
+			int x2 = x + GRID_DELTA[i][0];
+			int y2 = y + GRID_DELTA[i][1];
+			if(x2 < 0 || x2 >= row || y2 < 0 || y2 >= col || !is_passable(grid[x2][y2]))
+				continue;
+			float d = top.first + enter;
+			if(d < dist[x2*col + y2]){
+				dist[x2*col + y2] = d;
+				open.push(QueueEntry(d, x2*col + y2));
+			}
+		}
+	}
+
+	//確定したセル(bound以下)を含む矩形だけを残す
+	width = max_x - min_x + 1;
+	height = max_y - min_y + 1;
+	field.assign(width*height, INF);
+	for(int x = min_x; x <= max_x; x++){
+		for(int y = min_y; y <= max_y; y++){
+			float d = dist[x*col + y];
+			if(d <= bound)
+				field[(x - min_x) + width*(y - min_y)] = d;
+		}
+	}
+}
+
+float Navigation_function::value(int x, int y) const
+{
+	if(!is_exact(x, y))
+		return bound;
+	return field[(x - min_x) + width*(y - min_y)];
+}
+
+bool Navigation_function::is_exact(int x, int y) const
+{
+	if(x < min_x || x >= min_x + width || y < min_y || y >= min_y + height)
+		return false;
+	return field[(x - min_x) + width*(y - min_y)] != INF;
+}
+
+int Navigation_function::get_min_x(void) const
+{
+	return min_x;
+}
+
+int Navigation_function::get_min_y(void) const
+{
+	return min_y;
+}
+
+int Navigation_function::get_width(void) const
+{
+	return width;
+}
+
+int Navigation_function::get_height(void) const
+{
+	return height;
+}
+
+Cell Navigation_function::get_goal(void) const
+{
+	return goal;
+}
+
+const std::vector<float>& Navigation_function::get_field(void) const
+{
+	return field;
+}
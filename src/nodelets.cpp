@@ -0,0 +1,49 @@
+//a_star, localization, dwaのnodelet版(navigation_nodelet.launchで1つのmanagerに載せる)
+//同じプロセス内ではメッセージはシリアライズされず、shared_ptrのまま渡る
+#include <nodelet/nodelet.h>
+#include <pluginlib/class_list_macros.h>
+#include <boost/shared_ptr.hpp>
+#include "chibi19_a/a_star_node.h"
+#include "chibi19_a/dwa_node.h"
+#include "chibi19_a/localization_node.h"
+
+namespace chibi19_a
+{
+//コールバックはnodeletごとに1スレッドずつ順に呼ばれる(getNodeHandle)ので、各クラスは排他を持たない
+class A_star_nodelet : public nodelet::Nodelet
+{
+private:
+	boost::shared_ptr<A_star> node;
+
+	virtual void onInit(void)
+	{
+		node.reset(new A_star(getNodeHandle(), getPrivateNodeHandle()));
+	}
+};
+
+class Localization_nodelet : public nodelet::Nodelet
+{
+private:
+	boost::shared_ptr<Localization> node;
+
+	virtual void onInit(void)
+	{
+		node.reset(new Localization(getNodeHandle(), getPrivateNodeHandle()));
+	}
+};
+
+class Dwa_nodelet : public nodelet::Nodelet
+{
+private:
+	boost::shared_ptr<Dwa> node;
+
+	virtual void onInit(void)
+	{
+		node.reset(new Dwa(getNodeHandle(), getPrivateNodeHandle()));
+	}
+};
+}
+
+PLUGINLIB_EXPORT_CLASS(chibi19_a::A_star_nodelet, nodelet::Nodelet)
+PLUGINLIB_EXPORT_CLASS(chibi19_a::Localization_nodelet, nodelet::Nodelet)
+PLUGINLIB_EXPORT_CLASS(chibi19_a::Dwa_nodelet, nodelet::Nodelet)
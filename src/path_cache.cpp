@@ -0,0 +1,205 @@
+#include "chibi19_a/path_cache.h"
+#include "chibi19_a/theta_star.h"
+#include <cstdio>
+#include <cstring>
+#include <cstdlib>
+
+namespace
+{
+const char MAGIC[4] = {'C', '1', '9', 'P'};
+const uint32_t VERSION = 1;
+const uint64_t FNV_OFFSET = 14695981039346656037ULL;
+const uint64_t FNV_PRIME = 1099511628211ULL;
+
+uint64_t fnv1a(uint64_t h, const void* data, size_t size)
+{
+	const unsigned char* p = static_cast<const unsigned char*>(data);
+	for(size_t i = 0; i < size; i++){
+		h ^= p[i];
+		h *= FNV_PRIME;
+	}
+	return h;
+}
+
+bool passable(const std::vector<std::vector<char> >& grid, Cell c)
+{
+	return c.x >= 0 && c.x < grid.size() && c.y >= 0 && c.y < grid[0].size() && is_passable(grid[c.x][c.y]);
+}
+
+//隣接(8近傍)していない点の間は直線のセル列で埋める
+void append_cells(std::vector<Cell>& path, Cell c)
+{
+	if(path.empty()){
+		path.push_back(c);
+		return;
+	}
+	Cell last = path.back();
+	if(last.x == c.x && last.y == c.y)
+		return;
+	if(std::abs(c.x - last.x) <= 1 && std::abs(c.y - last.y) <= 1){
+		path.push_back(c);
+		return;
+	}
+	std::vector<Cell> line;
+	trace_line(last, c, line);
+	path.insert(path.end(), line.begin() + 1, line.end());
+}
+}
+
+uint64_t Path_cache::hash_grid(const std::vector<std::vector<char> >& grid, double resolution, double origin_x, double origin_y)
+{
+	uint64_t h = FNV_OFFSET;
+	uint32_t row = grid.size();
+	uint32_t col = row ? grid[0].size() : 0;
+
+	h = fnv1a(h, &row, sizeof(row));
+	h = fnv1a(h, &col, sizeof(col));
+	h = fnv1a(h, &resolution, sizeof(resolution));
+	h = fnv1a(h, &origin_x, sizeof(origin_x));
+	h = fnv1a(h, &origin_y, sizeof(origin_y));
+	for(uint32_t x = 0; x < row; x++){
+		h = fnv1a(h, &grid[x][0], col);
+	}
+
+	return h;
+}
+
+uint64_t Path_cache::make_key(uint64_t map_hash, Cell start, Cell goal, int quantum, const std::string& params)
+{
+	int32_t q[4] = {
+		start.x / quantum,
+		start.y / quantum,
+		goal.x / quantum,
+		goal.y / quantum
+	};
+	uint64_t h = fnv1a(FNV_OFFSET, &map_hash, sizeof(map_hash));
+	h = fnv1a(h, q, sizeof(q));
+	h = fnv1a(h, params.data(), params.size());
+
+	return h;
+}
+
+bool Path_cache::load(const std::string& file)
+{
+	FILE* fp;
+	char magic[4];
+	uint32_t version = 0;
+	uint32_t count = 0;
+
+	filename = file;
+	entries.clear();
+	fp = fopen(filename.c_str(), "rb");
+	if(fp == NULL)
+		return false;
+
+	bool ok = fread(magic, 1, 4, fp) == 4 && memcmp(magic, MAGIC, 4) == 0
+		&& fread(&version, sizeof(version), 1, fp) == 1 && version == VERSION
+		&& fread(&count, sizeof(count), 1, fp) == 1;
+	for(uint32_t i = 0; ok && i < count; i++){
+		uint64_t key;
+		int32_t first[2];
+		uint32_t steps;
+		ok = fread(&key, sizeof(key), 1, fp) == 1
+			&& fread(first, sizeof(int32_t), 2, fp) == 2
+			&& fread(&steps, sizeof(steps), 1, fp) == 1;
+		if(!ok)
+			break;
+
+		std::vector<unsigned char> moves(steps);
+		if(steps && fread(&moves[0], 1, steps, fp) != steps){
+			ok = false;
+			break;
+		}
+		std::vector<Cell> path(1);
+		path[0].x = first[0];
+		path[0].y = first[1];
+		for(uint32_t j = 0; j < steps; j++){
+			Cell c = {path.back().x + moves[j] / 3 - 1, path.back().y + moves[j] % 3 - 1};
+			path.push_back(c);
+		}
+		entries[key] = path;
+	}
+	fclose(fp);
+
+	if(!ok)
+		entries.clear();
+	return ok;
+}
+
+bool Path_cache::save(void) const
+{
+	if(filename.empty())
+		return false;
+
+	//書き込み途中で落ちても元のファイルが壊れないよう一時ファイルから置き換える
+	std::string tmp = filename + ".tmp";
+	FILE* fp = fopen(tmp.c_str(), "wb");
+	if(fp == NULL)
+		return false;
+
+	uint32_t count = entries.size();
+	bool ok = fwrite(MAGIC, 1, 4, fp) == 4
+		&& fwrite(&VERSION, sizeof(VERSION), 1, fp) == 1
+		&& fwrite(&count, sizeof(count), 1, fp) == 1;
+	for(std::unordered_map<uint64_t, std::vector<Cell> >::const_iterator it = entries.begin(); ok && it != entries.end(); ++it){
+		const std::vector<Cell>& path = it->second;
+		int32_t first[2] = {path[0].x, path[0].y};
+		uint32_t steps = path.size() - 1;
+		std::vector<unsigned char> moves(steps);
+		for(uint32_t j = 0; j < steps; j++){
+			moves[j] = (path[j+1].x - path[j].x + 1)*3 + (path[j+1].y - path[j].y + 1);
+		}
+		ok = fwrite(&it->first, sizeof(it->first), 1, fp) == 1
+			&& fwrite(first, sizeof(int32_t), 2, fp) == 2
+			&& fwrite(&steps, sizeof(steps), 1, fp) == 1
+			&& (!steps || fwrite(&moves[0], 1, steps, fp) == steps);
+	}
+	ok = (fclose(fp) == 0) && ok;
+
+	if(!ok || rename(tmp.c_str(), filename.c_str()) != 0){
+		remove(tmp.c_str());
+		return false;
+	}
+	return true;
+}
+
+bool Path_cache::find(uint64_t key, const std::vector<std::vector<char> >& grid, Cell start, Cell goal, int max_cost, std::vector<Cell>& path) const
+{
+	std::unordered_map<uint64_t, std::vector<Cell> >::const_iterator it = entries.find(key);
+
+	path.clear();
+	if(it == entries.end() || it->second.empty())
+		return false;
+
+	append_cells(path, start);
+	for(int i = 0; i < it->second.size(); i++){
+		append_cells(path, it->second[i]);
+	}
+	append_cells(path, goal);
+
+	for(int i = 0; i < path.size(); i++){
+		if(!passable(grid, path[i])
+				|| (i > 0 && i < path.size() - 1 && grid[path[i].x][path[i].y] > max_cost)){
+			path.clear();
+			return false;
+		}
+	}
+
+	return true;
+}
+
+void Path_cache::insert(uint64_t key, const std::vector<Cell>& path)
+{
+	std::vector<Cell> cells;
+
+	for(int i = 0; i < path.size(); i++){
+		append_cells(cells, path[i]);
+	}
+	if(!cells.empty())
+		entries[key] = cells;
+}
+
+int Path_cache::size(void) const
+{
+	return entries.size();
+}
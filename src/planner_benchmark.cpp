@@ -0,0 +1,691 @@
+//経路探索エンジンのベンチマーク(ROSに依存しない)
+//固定の乱数系列で作ったstart/goalの組を、実地図と生成した迷路・部屋・開けた場所の各サイズで解き、
+//エンジンごとに展開ノード数、時間、ヒープの最大使用量(作業領域を含む)、経路コストを出力する
+//最初にshortcut_segmentsが周回・往復の経路でwaypointを残すかを確かめ、残らなければ1で終わる
+//
+//usage: planner_benchmark [map.yaml] [-q queries] [-s seed] [-n 200,400,800]
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <chrono>
+#include <fstream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include "chibi19_a/d_star_lite.h"
+#include "chibi19_a/theta_star.h"
+#include "chibi19_a/ara_star.h"
+#include "chibi19_a/navigation_function.h"
+#include "chibi19_a/multi_resolution.h"
+#include "chibi19_a/grid_search.h"
+
+//ヒープの使用量を数えるため、このプログラムではnew/deleteを置き換える
+namespace
+{
+size_t heap_current = 0;
+size_t heap_peak = 0;
+const size_t HEADER = 16;
+
+void* counted_alloc(size_t size)
+{
+	char* p = static_cast<char*>(malloc(size + HEADER));
+	if(p == NULL)
+		throw std::bad_alloc();
+	*reinterpret_cast<size_t*>(p) = size;
+	heap_current += size;
+	heap_peak = std::max(heap_peak, heap_current);
+	return p + HEADER;
+}
+
+void counted_free(void* ptr)
+{
+	if(ptr == NULL)
+		return;
+	char* p = static_cast<char*>(ptr) - HEADER;
+	heap_current -= *reinterpret_cast<size_t*>(p);
+	free(p);
+}
+}
+
+void* operator new(size_t size)
+{
+	return counted_alloc(size);
+}
+
+void* operator new[](size_t size)
+{
+	return counted_alloc(size);
+}
+
+void operator delete(void* ptr) noexcept
+{
+	counted_free(ptr);
+}
+
+void operator delete[](void* ptr) noexcept
+{
+	counted_free(ptr);
+}
+
+typedef std::vector<std::vector<char> > Grid;
+
+struct Scenario{
+	std::string name;
+	Grid grid;
+	double resolution;
+};
+
+struct Query{
+	Cell s;
+	Cell g;
+};
+
+//localizationのcost_mapと同じく、障害物からの距離d[m]が2m未満なら100-50d、それ以上は-1
+void make_cost(Grid& grid, double resolution)
+{
+	const int row = grid.size();
+	const int col = grid[0].size();
+	const float INF = 1e9;
+	const float D = 1.0f;
+	const float D2 = 1.41421356f;
+	std::vector<float> dist(row*col, INF);
+
+	for(int x = 0; x < row; x++){
+		for(int y = 0; y < col; y++){
+			if(grid[x][y] == 100)
+				dist[x*col + y] = 0;
+		}
+	}
+	//2パスのchamfer距離変換
+	for(int x = 0; x < row; x++){
+		for(int y = 0; y < col; y++){
+			float& d = dist[x*col + y];
+			if(x > 0){
+				d = std::min(d, dist[(x-1)*col + y] + D);
+				if(y > 0)
+					d = std::min(d, dist[(x-1)*col + y-1] + D2);
+				if(y < col-1)
+					d = std::min(d, dist[(x-1)*col + y+1] + D2);
+			}
+			if(y > 0)
+				d = std::min(d, dist[x*col + y-1] + D);
+		}
+	}
+	for(int x = row-1; x >= 0; x--){
+		for(int y = col-1; y >= 0; y--){
+			float& d = dist[x*col + y];
+			if(x < row-1){
+				d = std::min(d, dist[(x+1)*col + y] + D);
+				if(y > 0)
+					d = std::min(d, dist[(x+1)*col + y-1] + D2);
+				if(y < col-1)
+					d = std::min(d, dist[(x+1)*col + y+1] + D2);
+			}
+			if(y < col-1)
+				d = std::min(d, dist[x*col + y+1] + D);
+		}
+	}
+
+	for(int x = 0; x < row; x++){
+		for(int y = 0; y < col; y++){
+			double d = dist[x*col + y] * resolution;
+			grid[x][y] = d < 2.0 ? (char)(100 - 50*d) : -1;
+		}
+	}
+}
+
+void fill_rect(Grid& grid, int x0, int y0, int x1, int y1, char value = 100)
+{
+	for(int x = std::max(x0, 0); x < std::min(x1, (int)grid.size()); x++){
+		for(int y = std::max(y0, 0); y < std::min(y1, (int)grid[0].size()); y++){
+			grid[x][y] = value;
+		}
+	}
+}
+
+void add_border(Grid& grid)
+{
+	int n = grid.size();
+	fill_rect(grid, 0, 0, n, 2);
+	fill_rect(grid, 0, n-2, n, n);
+	fill_rect(grid, 0, 0, 2, n);
+	fill_rect(grid, n-2, 0, n, n);
+}
+
+//円形の障害物を散らした開けた場所
+Grid make_open_field(int n, std::mt19937& rng)
+{
+	Grid grid(n, std::vector<char>(n, 0));
+	int count = n*n / 2000;
+
+	for(int i = 0; i < count; i++){
+		int cx = rng() % n;
+		int cy = rng() % n;
+		int r = 5 + rng() % 16;
+		for(int x = std::max(cx-r, 0); x <= std::min(cx+r, n-1); x++){
+			for(int y = std::max(cy-r, 0); y <= std::min(cy+r, n-1); y++){
+				if((x-cx)*(x-cx) + (y-cy)*(y-cy) <= r*r)
+					grid[x][y] = 100;
+			}
+		}
+	}
+	add_border(grid);
+
+	return grid;
+}
+
+//3m四方の部屋が並び、壁ごとに1mのドアが1つある
+Grid make_rooms(int n, std::mt19937& rng)
+{
+	const int ROOM = 60;
+	const int WALL = 2;
+	const int DOOR = 20;
+	Grid grid(n, std::vector<char>(n, 0));
+
+	for(int w = ROOM; w < n; w += ROOM){
+		fill_rect(grid, w, 0, w+WALL, n);
+		fill_rect(grid, 0, w, n, w+WALL);
+	}
+	for(int w = ROOM; w < n; w += ROOM){
+		for(int r = 0; r < n; r += ROOM){
+			int door = r + WALL + rng() % (ROOM - DOOR - WALL);
+			for(int x = w; x < w+WALL; x++){
+				for(int y = door; y < std::min(door+DOOR, n); y++){
+					grid[x][y] = 0;
+					grid[y][x] = 0;
+				}
+			}
+		}
+	}
+	add_border(grid);
+
+	return grid;
+}
+
+//通路幅1.2mの迷路(深さ優先で掘る)
+Grid make_maze(int n, std::mt19937& rng)
+{
+	const int PASSAGE = 24;
+	const int WALL = 4;
+	const int PITCH = PASSAGE + WALL;
+	const int m = (n - WALL) / PITCH;
+	Grid grid(n, std::vector<char>(n, 100));
+	std::vector<bool> visited(m*m, false);
+	std::vector<int> stack;
+
+	if(m < 1)
+		return grid;
+	stack.push_back(0);
+	visited[0] = true;
+	while(!stack.empty()){
+		int c = stack.back();
+		int cx = c / m;
+		int cy = c % m;
+		fill_rect(grid, WALL + cx*PITCH, WALL + cy*PITCH, (cx+1)*PITCH, (cy+1)*PITCH, 0);
+
+		int next[4];
+		int num = 0;
+		const int dx[4] = {-1, 0, 1, 0};
+		const int dy[4] = {0, -1, 0, 1};
+		for(int i = 0; i < 4; i++){
+			int nx = cx + dx[i];
+			int ny = cy + dy[i];
+			if(nx >= 0 && nx < m && ny >= 0 && ny < m && !visited[nx*m + ny])
+				next[num++] = i;
+		}
+		if(!num){
+			stack.pop_back();
+			continue;
+		}
+		int i = next[rng() % num];
+		int nx = cx + dx[i];
+		int ny = cy + dy[i];
+		//間の壁を抜く
+		fill_rect(grid, WALL + std::min(cx, nx)*PITCH, WALL + std::min(cy, ny)*PITCH,
+				(std::max(cx, nx)+1)*PITCH, (std::max(cy, ny)+1)*PITCH, 0);
+		visited[nx*m + ny] = true;
+		stack.push_back(nx*m + ny);
+	}
+
+	return grid;
+}
+
+//map_serverと同じ規則でpgmを読む(grid[x][y]のyは画像の下から)
+bool load_map(const std::string& yaml, Scenario& scenario)
+{
+	std::ifstream ifs(yaml.c_str());
+	std::string line;
+	std::string image;
+	double free_thresh = 0.196;
+	int negate = 0;
+
+	if(!ifs)
+		return false;
+	scenario.resolution = 0.05;
+	while(std::getline(ifs, line)){
+		std::string::size_type colon = line.find(':');
+		if(colon == std::string::npos)
+			continue;
+		std::string key = line.substr(0, colon);
+		std::istringstream value(line.substr(colon + 1));
+		if(key == "image")
+			value >> image;
+		else if(key == "resolution")
+			value >> scenario.resolution;
+		else if(key == "negate")
+			value >> negate;
+		else if(key == "free_thresh")
+			value >> free_thresh;
+	}
+	if(image.empty())
+		return false;
+	if(image[0] != '/'){
+		std::string::size_type slash = yaml.rfind('/');
+		if(slash != std::string::npos)
+			image = yaml.substr(0, slash + 1) + image;
+	}
+
+	std::ifstream pgm(image.c_str(), std::ios::binary);
+	std::string magic;
+	int header[3];
+	if(!pgm || !(pgm >> magic) || magic != "P5"){
+		fprintf(stderr, "cannot read %s (binary pgm)\n", image.c_str());
+		return false;
+	}
+	for(int i = 0; i < 3; ){
+		pgm >> std::ws;
+		if(pgm.peek() == '#'){
+			std::getline(pgm, line);
+			continue;
+		}
+		if(!(pgm >> header[i++]))
+			return false;
+	}
+	pgm.get();
+
+	const int width = header[0];
+	const int height = header[1];
+	std::vector<unsigned char> pixels(width*height);
+	if(!pgm.read(reinterpret_cast<char*>(&pixels[0]), pixels.size()))
+		return false;
+
+	scenario.grid = Grid(width, std::vector<char>(height, 0));
+	for(int row = 0; row < height; row++){
+		for(int x = 0; x < width; x++){
+			double p = pixels[row*width + x] / 255.0;
+			if(!negate)
+				p = 1.0 - p;
+			//未知領域も通れないものとして扱う
+			scenario.grid[x][height-1-row] = p < free_thresh ? 0 : 100;
+		}
+	}
+
+	return true;
+}
+
+//障害物から0.4m以上離れたセルからstartとgoalを選ぶ(seedが同じなら毎回同じ組)
+void make_queries(const Grid& grid, int count, unsigned int seed, std::vector<Query>& queries)
+{
+	std::mt19937 rng(seed);
+	std::vector<Cell> free_cells;
+	const int row = grid.size();
+	const int col = grid[0].size();
+	const int min_dist = std::min(row, col) / 4;
+
+	for(int x = 0; x < row; x++){
+		for(int y = 0; y < col; y++){
+			if(grid[x][y] < 80){
+				Cell c = {x, y};
+				free_cells.push_back(c);
+			}
+		}
+	}
+	queries.clear();
+	if(free_cells.empty())
+		return;
+	for(int tries = 0; queries.size() < count && tries < count*100; tries++){
+		Query q = {free_cells[rng() % free_cells.size()], free_cells[rng() % free_cells.size()]};
+		if(std::abs(q.s.x - q.g.x) + std::abs(q.s.y - q.g.y) >= min_dist)
+			queries.push_back(q);
+	}
+}
+
+//a_starなどと同じく、入るセルのコスト(1+cost)に移動距離を掛けて足す
+//隣接していない点の間(theta_starの頂点列)は直線の長さと、その直線が通るセルのコストで測る
+double path_cost(const Grid& grid, const std::vector<Cell>& path, double& length)
+{
+	double cost = 0;
+
+	length = 0;
+	for(int i = 1; i < path.size(); i++){
+		int dx = std::abs(path[i].x - path[i-1].x);
+		int dy = std::abs(path[i].y - path[i-1].y);
+		if(dx <= 1 && dy <= 1){
+			double step = (dx && dy) ? M_SQRT2 : 1.0;
+			cost += step * enter_cost(grid[path[i].x][path[i].y]);
+			length += step;
+		} else {
+			cost += line_cost(grid, path[i-1], path[i], 100);
+			length += std::hypot(dx, dy);
+		}
+	}
+
+	return cost;
+}
+
+class Engine
+{
+public:
+	virtual ~Engine(void) {}
+	virtual const char* name(void) const = 0;
+	//地図ごとの前処理(時間には含めない)
+	virtual void prepare(const Scenario&) {}
+	virtual bool search(const Scenario&, Cell, Cell, std::vector<Cell>&, int&) = 0;
+};
+
+class Grid_search_engine : public Engine
+{
+private:
+	std::string label;
+	std::unique_ptr<Grid_search_base> kernel;
+
+public:
+	Grid_search_engine(const std::string& l, int neighborhood, const std::string& heuristic)
+		: label(l), kernel(create_grid_search(neighborhood, heuristic, "cost_map", NULL)) {}
+	const char* name(void) const
+	{
+		return label.c_str();
+	}
+	bool search(const Scenario& sc, Cell s, Cell g, std::vector<Cell>& path, int& expansions)
+	{
+		bool found = kernel->search(sc.grid, s, g, path);
+		expansions = kernel->get_expansions();
+		return found;
+	}
+};
+
+class Nav_function_engine : public Engine
+{
+private:
+	Navigation_function nav;
+	std::unique_ptr<Grid_search_base> kernel;
+
+public:
+	Nav_function_engine(void) : kernel(create_grid_search(4, "nav_function", "cost_map", &nav)) {}
+	const char* name(void) const
+	{
+		return "a_star_nav_function";
+	}
+	bool search(const Scenario& sc, Cell s, Cell g, std::vector<Cell>& path, int& expansions)
+	{
+		nav.compute(sc.grid, g, s, 3.0 / sc.resolution);
+		bool found = kernel->search(sc.grid, s, g, path);
+		expansions = kernel->get_expansions();
+		return found;
+	}
+};
+
+class D_star_engine : public Engine
+{
+public:
+	const char* name(void) const
+	{
+		return "d_star_lite";
+	}
+	bool search(const Scenario& sc, Cell s, Cell g, std::vector<Cell>& path, int& expansions)
+	{
+		D_star_lite d_star;
+		d_star.init(sc.grid, s, g);
+		bool found = d_star.compute_path() && d_star.get_path(path);
+		expansions = d_star.get_expansions();
+		return found;
+	}
+};
+
+class Theta_star_engine : public Engine
+{
+public:
+	const char* name(void) const
+	{
+		return "theta_star";
+	}
+	bool search(const Scenario& sc, Cell s, Cell g, std::vector<Cell>& path, int& expansions)
+	{
+		Theta_star theta_star;
+		theta_star.set_los_max_cost(90);
+		//頂点列のまま返し、長さとコストは頂点間の直線で測る
+		bool found = theta_star.search(sc.grid, s, g, path);
+		expansions = theta_star.get_expansions();
+		return found;
+	}
+};
+
+//epsilon=3から0.5ずつ下げて1まで(時間制限なし)
+class ARA_star_engine : public Engine
+{
+public:
+	const char* name(void) const
+	{
+		return "ara_star";
+	}
+	bool search(const Scenario& sc, Cell s, Cell g, std::vector<Cell>& path, int& expansions)
+	{
+		ARA_star ara_star;
+		ara_star.init(sc.grid, s, g, 3.0);
+		do{
+			if(!ara_star.improve_path(std::chrono::steady_clock::time_point::max()))
+				break;
+		}while(ara_star.decrease_epsilon(0.5));
+		expansions = ara_star.get_expansions();
+		return ara_star.has_path() && ara_star.get_path(path);
+	}
+};
+
+class Multi_resolution_engine : public Engine
+{
+private:
+	Multi_resolution_planner planner;
+	int corridor;
+
+public:
+	const char* name(void) const
+	{
+		return "multi_resolution";
+	}
+	void prepare(const Scenario& sc)
+	{
+		planner.build(sc.grid, 2);
+		corridor = ceil(1.0 / (sc.resolution * (1 << planner.get_levels())));
+	}
+	bool search(const Scenario&, Cell s, Cell g, std::vector<Cell>& path, int& expansions)
+	{
+		bool found = planner.search(s, g, corridor, path);
+		expansions = planner.get_expansions();
+		return found;
+	}
+};
+
+//e番目のエンジンを新しく作る(eが範囲外ならNULL)
+Engine* make_engine(int e)
+{
+	switch(e){
+	case 0: return new Grid_search_engine("a_star", 4, "manhattan");
+	case 1: return new Grid_search_engine("a_star_8_octile", 8, "octile");
+	case 2: return new Nav_function_engine();
+	case 3: return new D_star_engine();
+	case 4: return new Theta_star_engine();
+	case 5: return new ARA_star_engine();
+	case 6: return new Multi_resolution_engine();
+	default: return NULL;
+	}
+}
+
+//エンジンはシナリオごとに作り直し、peakは作ってから全クエリを解き終わるまでのヒープの最大増加量
+//(作業領域を使い回すエンジンでも、その確保がどのシナリオでも含まれる)
+void run_scenario(const Scenario& sc, int num_queries, unsigned int seed)
+{
+	std::vector<Query> queries;
+	make_queries(sc.grid, num_queries, seed, queries);
+
+	printf("\n== %s (%dx%d, %.2fm, %d queries)\n", sc.name.c_str(), (int)sc.grid.size(), (int)sc.grid[0].size(),
+			sc.resolution, (int)queries.size());
+	printf("%-22s %7s %12s %10s %10s %12s %10s %9s\n",
+			"engine", "solved", "expansions", "mean[ms]", "max[ms]", "peak[KB]", "cost", "length[m]");
+
+	for(int e = 0; ; e++){
+		const size_t base = heap_current;
+		heap_peak = heap_current;
+		std::unique_ptr<Engine> created(make_engine(e));
+		if(!created)
+			break;
+		Engine& engine = *created;
+		int solved = 0;
+		long long expansions = 0;
+		double total_ms = 0;
+		double max_ms = 0;
+		double total_cost = 0;
+		double total_length = 0;
+
+		engine.prepare(sc);
+		for(int i = 0; i < queries.size(); i++){
+			std::vector<Cell> path;
+			int exp = 0;
+
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+			bool found = engine.search(sc, queries[i].s, queries[i].g, path, exp);
+			double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+			total_ms += ms;
+			max_ms = std::max(max_ms, ms);
+			expansions += exp;
+			if(found && !path.empty()){
+				double length;
+				solved++;
+				total_cost += path_cost(sc.grid, path, length);
+				total_length += length * sc.resolution;
+			}
+		}
+
+		const size_t peak = heap_peak - base;
+		int n = std::max((int)queries.size(), 1);
+		int m = std::max(solved, 1);
+		printf("%-22s %3d/%-3d %12lld %10.2f %10.2f %12zu %10.1f %9.2f\n",
+				engine.name(), solved, (int)queries.size(), expansions / n, total_ms / n, max_ms,
+				peak / 1024, total_cost / m, total_length / m);
+	}
+}
+
+//waypointを通る区間の列をshortcut_segmentsで直線化し、どのwaypointのセルも頂点に順に残るか確かめる
+//(区間は隣接セルの階段状の列にする)
+bool check_waypoints_survive(const char* label, const std::vector<Cell>& waypoints)
+{
+	Grid grid(20, std::vector<char>(20, 0));
+	std::vector<std::vector<Cell> > segments;
+	std::vector<Cell> vertices;
+
+	for(int i = 1; i < waypoints.size(); i++){
+		std::vector<Cell> line;
+		trace_line(waypoints[i-1], waypoints[i], line);
+		segments.push_back(line);
+	}
+	shortcut_segments(grid, segments, vertices, 90);
+
+	int k = 0;
+	for(int i = 0; i < vertices.size() && k < waypoints.size(); i++){
+		if(vertices[i].x == waypoints[k].x && vertices[i].y == waypoints[k].y)
+			k++;
+	}
+	printf("shortcut check %-14s %d/%d waypoints kept, %d vertices\n", label, k, (int)waypoints.size(), (int)vertices.size());
+	return k == waypoints.size();
+}
+
+//周回(始点に戻る四角)と往復の経路
+bool check_shortcut(void)
+{
+	const Cell loop[5] = {{5, 5}, {5, 15}, {15, 15}, {15, 5}, {5, 5}};
+	const Cell out_and_back[3] = {{5, 5}, {15, 12}, {5, 5}};
+	bool ok = check_waypoints_survive("loop", std::vector<Cell>(loop, loop + 5));
+
+	ok = check_waypoints_survive("out_and_back", std::vector<Cell>(out_and_back, out_and_back + 3)) && ok;
+	return ok;
+}
+
+std::vector<int> parse_scales(const char* arg)
+{
+	std::vector<int> scales;
+	std::istringstream ss(arg);
+	std::string item;
+
+	while(std::getline(ss, item, ',')){
+		int n = atoi(item.c_str());
+		if(n > 0)
+			scales.push_back(n);
+	}
+	return scales;
+}
+
+int main(int argc, char** argv)
+{
+	std::string map_yaml;
+	int num_queries = 10;
+	unsigned int seed = 1;
+	std::vector<int> scales;
+	scales.push_back(200);
+	scales.push_back(400);
+	scales.push_back(800);
+
+	for(int i = 1; i < argc; i++){
+		if(!strcmp(argv[i], "-q") && i+1 < argc)
+			num_queries = atoi(argv[++i]);
+		else if(!strcmp(argv[i], "-s") && i+1 < argc)
+			seed = strtoul(argv[++i], NULL, 10);
+		else if(!strcmp(argv[i], "-n") && i+1 < argc)
+			scales = parse_scales(argv[++i]);
+		else if(argv[i][0] != '-')
+			map_yaml = argv[i];
+		else{
+			fprintf(stderr, "usage: %s [map.yaml] [-q queries] [-s seed] [-n 200,400,800]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	if(!check_shortcut())
+		return 1;
+	printf("seed %u, %d queries per map\n", seed, num_queries);
+
+	if(!map_yaml.empty()){
+		Scenario sc;
+		sc.name = map_yaml;
+		if(load_map(map_yaml, sc)){
+			make_cost(sc.grid, sc.resolution);
+			run_scenario(sc, num_queries, seed);
+		}else{
+			fprintf(stderr, "skip %s: cannot load map\n", map_yaml.c_str());
+		}
+	}
+
+	for(int i = 0; i < scales.size(); i++){
+		const int n = scales[i];
+		const char* kinds[3] = {"open_field", "rooms", "maze"};
+		for(int k = 0; k < 3; k++){
+			std::mt19937 rng(seed + n*3 + k);
+			Scenario sc;
+			sc.name = std::string(kinds[k]) + "_" + std::to_string(n);
+			sc.resolution = 0.05;
+			if(k == 0)
+				sc.grid = make_open_field(n, rng);
+			else if(k == 1)
+				sc.grid = make_rooms(n, rng);
+			else
+				sc.grid = make_maze(n, rng);
+			make_cost(sc.grid, sc.resolution);
+			run_scenario(sc, num_queries, seed);
+		}
+	}
+
+	return 0;
+}
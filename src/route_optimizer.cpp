@@ -0,0 +1,241 @@
+#include "chibi19_a/route_optimizer.h"
+#include <cmath>
+#include <limits>
+#include <queue>
+#include <algorithm>
+
+namespace
+{
+const double INF = std::numeric_limits<double>::infinity();
+//Held-Karpで厳密に解く最大の点数(始点を除く)
+const int EXACT_MAX = 12;
+
+typedef std::pair<float, int> QueueEntry;
+
+void dijkstra(const std::vector<std::vector<char> >& grid, Cell source, const std::vector<Cell>& targets,
+		std::vector<float>& dist, std::vector<int>& touched, std::vector<double>& costs)
+{
+	int row = grid.size();
+	int col = grid[0].size();
+	int remaining = 0;
+	std::vector<int> target_ids;
+	std::priority_queue<QueueEntry, std::vector<QueueEntry>, std::greater<QueueEntry> > open;
+
+	costs.assign(targets.size(), INF);
+	for(int i = 0; i < targets.size(); i++){
+		if(targets[i].x < 0 || targets[i].x >= row || targets[i].y < 0 || targets[i].y >= col){
+			target_ids.push_back(-1);
+		} else {
+			target_ids.push_back(targets[i].x*col + targets[i].y);
+			remaining++;
+		}
+	}
+	if(source.x < 0 || source.x >= row || source.y < 0 || source.y >= col)
+		return;
+
+	int s_id = source.x*col + source.y;
+	dist[s_id] = 0.0f;
+	touched.push_back(s_id);
+	open.push(QueueEntry(0.0f, s_id));
+
+	//全ての目標点のコストが確定したら打ち切る
+	while(!open.empty() && remaining > 0){
+		QueueEntry top = open.top();
+		open.pop();
+		if(top.first > dist[top.second])
+			continue;
+
+		for(int i = 0; i < target_ids.size(); i++){
+			if(target_ids[i] == top.second && costs[i] == INF){
+				costs[i] = top.first;
+				remaining--;
+			}
+		}
+
+		int x = top.second / col;
+		int y = top.second % col;
+		for(int i = 0; i < 4; i++){
+			int x2 = x + GRID_DELTA[i][0];
+			int y2 = y + GRID_DELTA[i][1];
+			if(x2 < 0 || x2 >= row || y2 < 0 || y2 >= col || !is_passable(grid[x2][y2]))
+				continue;
+			int id2 = x2*col + y2;
+			float d = top.first + enter_cost(grid[x2][y2]);
+			if(d < dist[id2]){
+				if(dist[id2] == std::numeric_limits<float>::infinity())
+					touched.push_back(id2);
+				dist[id2] = d;
+				open.push(QueueEntry(d, id2));
+			}
+		}
+	}
+
+	//次の始点のために触ったセルだけ戻す
+	for(int i = 0; i < touched.size(); i++){
+		dist[touched[i]] = std::numeric_limits<float>::infinity();
+	}
+	touched.clear();
+}
+
+void held_karp(const std::vector<std::vector<double> >& cost, std::vector<int>& order)
+{
+	int n = cost.size() - 1;
+	int full = (1 << n) - 1;
+	std::vector<std::vector<double> > dp(1 << n, std::vector<double>(n, INF));
+	std::vector<std::vector<char> > prev(1 << n, std::vector<char>(n, -1));
+
+	for(int j = 0; j < n; j++){
+		dp[1 << j][j] = cost[0][j+1];
+	}
+	for(int set = 1; set <= full; set++){
+		for(int j = 0; j < n; j++){
+			if(!(set & (1 << j)) || dp[set][j] == INF)
+				continue;
+			for(int k = 0; k < n; k++){
+				if(set & (1 << k))
+					continue;
+				double c = dp[set][j] + cost[j+1][k+1];
+				int next = set | (1 << k);
+				if(c < dp[next][k]){
+					dp[next][k] = c;
+					prev[next][k] = j;
+				}
+			}
+		}
+	}
+
+	int last = 0;
+	double best = INF;
+	for(int j = 0; j < n; j++){
+		double c = dp[full][j] + cost[j+1][0];
+		if(c < best){
+			best = c;
+			last = j;
+		}
+	}
+
+	order.clear();
+	int set = full;
+	while(last >= 0){
+		order.push_back(last + 1);
+		int p = prev[set][last];
+		set &= ~(1 << last);
+		last = p;
+	}
+	order.push_back(0);
+	std::reverse(order.begin(), order.end());
+}
+
+void nearest_neighbor(const std::vector<std::vector<double> >& cost, std::vector<int>& order)
+{
+	int n = cost.size();
+	std::vector<bool> visited(n, false);
+
+	order.clear();
+	order.push_back(0);
+	visited[0] = true;
+	for(int i = 1; i < n; i++){
+		int cur = order.back();
+		int next = -1;
+		for(int j = 1; j < n; j++){
+			if(!visited[j] && (next < 0 || cost[cur][j] < cost[cur][next]))
+				next = j;
+		}
+		order.push_back(next);
+		visited[next] = true;
+	}
+}
+
+//コスト行列は非対称になりうるので、候補ごとに巡回路全体のコストで比較する
+void local_search(const std::vector<std::vector<double> >& cost, std::vector<int>& order)
+{
+	int n = order.size();
+	double best = tour_cost(cost, order);
+	bool improved = true;
+
+	while(improved){
+		improved = false;
+
+		//2-opt: order[i..j]を反転
+		for(int i = 1; i < n - 1; i++){
+			for(int j = i + 1; j < n; j++){
+				std::reverse(order.begin() + i, order.begin() + j + 1);
+				double c = tour_cost(cost, order);
+				if(c + 1e-9 < best){
+					best = c;
+					improved = true;
+				} else {
+					std::reverse(order.begin() + i, order.begin() + j + 1);
+				}
+			}
+		}
+
+		//Or-opt: 長さ1~3の区間を別の位置へ移動
+		for(int len = 1; len <= 3; len++){
+			for(int i = 1; i + len <= n; i++){
+				for(int j = 1; j <= n - len; j++){
+					if(j == i)
+						continue;
+					std::vector<int> moved(order);
+					std::vector<int> chunk(moved.begin() + i, moved.begin() + i + len);
+					moved.erase(moved.begin() + i, moved.begin() + i + len);
+					moved.insert(moved.begin() + j, chunk.begin(), chunk.end());
+					double c = tour_cost(cost, moved);
+					if(c + 1e-9 < best){
+						best = c;
+						order = moved;
+						improved = true;
+					}
+				}
+			}
+		}
+	}
+}
+}
+
+void calc_cost_matrix(const std::vector<std::vector<char> >& grid, const std::vector<Cell>& points, std::vector<std::vector<double> >& cost)
+{
+	int size = grid.size() * (grid.empty() ? 0 : grid[0].size());
+	std::vector<float> dist(size, std::numeric_limits<float>::infinity());
+	std::vector<int> touched;
+
+	cost.assign(points.size(), std::vector<double>(points.size(), INF));
+	if(!size)
+		return;
+
+	for(int i = 0; i < points.size(); i++){
+		dijkstra(grid, points[i], points, dist, touched, cost[i]);
+	}
+}
+
+double tour_cost(const std::vector<std::vector<double> >& cost, const std::vector<int>& order)
+{
+	double c = 0.0;
+
+	for(int i = 0; i < order.size(); i++){
+		c += cost[order[i]][order[(i + 1) % order.size()]];
+	}
+
+	return c;
+}
+
+bool solve_tour(const std::vector<std::vector<double> >& cost, std::vector<int>& order)
+{
+	int n = cost.size();
+
+	order.clear();
+	if(n == 0)
+		return false;
+	if(n <= 2){
+		for(int i = 0; i < n; i++){
+			order.push_back(i);
+		}
+	} else if(n - 1 <= EXACT_MAX){
+		held_karp(cost, order);
+	} else {
+		nearest_neighbor(cost, order);
+		local_search(cost, order);
+	}
+
+	return tour_cost(cost, order) < INF;
+}
@@ -0,0 +1,89 @@
+#include "chibi19_a/scan_filter.h"
+#include <cmath>
+#include <algorithm>
+
+Scan_filter_params::Scan_filter_params(void)
+{
+	min_range = 0.0;
+	max_range = 0.0;
+	beam_step = 1;
+	max_beams = 0;
+}
+
+Scan_filter::Scan_filter(void)
+{
+	angle_min = 0.0;
+	angle_increment = 0.0;
+	size = -1;
+}
+
+void Scan_filter::init(const Scan_filter_params& p)
+{
+	params = p;
+	size = -1;
+	return;
+}
+
+bool Scan_filter::is_masked(double theta) const
+{
+	for(int i = 0; i + 1 < params.mask.size(); i += 2){
+		if(params.mask[i] < theta && theta < params.mask[i + 1]) return true;
+	}
+	return false;
+}
+
+//間引きの間隔はmax_beamsから決める(マスクで落とすビームも数に入れる)
+void Scan_filter::build(const Scan& scan)
+{
+	int step = std::max(params.beam_step, 1);
+
+	angle_min = scan.angle_min;
+	angle_increment = scan.angle_increment;
+	size = scan.ranges.size();
+	if(params.max_beams == 1){
+		step = std::max(step, size);
+	} else if(params.max_beams > 1 && size > params.max_beams){
+		step = std::max(step, (size - 1)/(params.max_beams - 1));
+	}
+
+	indices.clear();
+	c.clear();
+	s.clear();
+	for(int j = 0; j < size; j += step){
+		double theta = scan.angle_min + j*scan.angle_increment;
+
+		if(is_masked(theta)) continue;
+		indices.push_back(j);
+		c.push_back(std::cos(theta));
+		s.push_back(std::sin(theta));
+	}
+	return;
+}
+
+void Scan_filter::apply(const Scan& scan, Filtered_scan& out)
+{
+	if(scan.ranges.size() != size || scan.angle_min != angle_min || scan.angle_increment != angle_increment){
+		build(scan);
+	}
+
+	out.range_min = scan.range_min;
+	out.range_max = scan.range_max;
+	if(params.min_range > 0.0) out.range_min = std::max(out.range_min, params.min_range);
+	if(params.max_range > 0.0) out.range_max = std::min(out.range_max, params.max_range);
+
+	out.beams.clear();
+	for(int i = 0; i < indices.size(); i++){
+		double r = scan.ranges[indices[i]];
+
+		//nan, infもここで落ちる
+		if(!(out.range_min < r && r < out.range_max)) continue;
+		Beam b = {r, c[i], s[i]};
+		out.beams.push_back(b);
+	}
+	return;
+}
+
+const Scan_filter_params& Scan_filter::get_params(void) const
+{
+	return params;
+}
@@ -0,0 +1,252 @@
+#include "chibi19_a/theta_star.h"
+#include <cmath>
+#include <limits>
+#include <queue>
+#include <algorithm>
+
+namespace
+{
+const double INF = std::numeric_limits<double>::infinity();
+}
+
+void trace_line(Cell a, Cell b, std::vector<Cell>& cells)
+{
+	int dx = std::abs(b.x - a.x);
+	int dy = std::abs(b.y - a.y);
+	int x_inc = (b.x > a.x) ? 1 : -1;
+	int y_inc = (b.y > a.y) ? 1 : -1;
+	int error = dx - dy;
+	Cell c = a;
+
+	dx *= 2;
+	dy *= 2;
+	for(int n = 1 + dx/2 + dy/2; n > 0; n--){
+		cells.push_back(c);
+		if(error > 0){
+			c.x += x_inc;
+			error -= dy;
+		} else {
+			c.y += y_inc;
+			error += dx;
+		}
+	}
+}
+
+//格子上の1マス移動(進入セルのコスト1+c)と同じ尺度になるよう、直線長×平均コストとする
+//trace_lineと同じ順にセルをたどりながら足し、通れないセルに当たった時点で打ち切る
+double line_cost(const std::vector<std::vector<char> >& grid, Cell a, Cell b, int max_cost)
+{
+	int row = grid.size();
+	int col = row ? grid[0].size() : 0;
+	int dx = std::abs(b.x - a.x);
+	int dy = std::abs(b.y - a.y);
+	int x_inc = (b.x > a.x) ? 1 : -1;
+	int y_inc = (b.y > a.y) ? 1 : -1;
+	int error = dx - dy;
+	int steps = dx + dy;
+	double sum = 0.0;
+	Cell c = a;
+
+	dx *= 2;
+	dy *= 2;
+	for(int n = 0; n <= steps; n++){
+		if(c.x < 0 || c.x >= row || c.y < 0 || c.y >= col)
+			return INF;
+		char v = grid[c.x][c.y];
+		if(!is_passable(v) || v > max_cost)
+			return INF;
+		if(n > 0)
+			sum += enter_cost(v);
+		if(error > 0){
+			c.x += x_inc;
+			error -= dy;
+		} else {
+			c.y += y_inc;
+			error += dx;
+		}
+	}
+	if(steps == 0)
+		return 0.0;
+
+	return std::hypot(b.x - a.x, b.y - a.y) * sum / steps;
+}
+
+bool line_of_sight(const std::vector<std::vector<char> >& grid, Cell a, Cell b, int max_cost)
+{
+	return line_cost(grid, a, b, max_cost) < INF;
+}
+
+void expand_path(const std::vector<Cell>& vertices, std::vector<Cell>& cells)
+{
+	cells.clear();
+	if(vertices.empty())
+		return;
+
+	cells.push_back(vertices[0]);
+	for(int i = 1; i < vertices.size(); i++){
+		std::vector<Cell> line;
+		trace_line(vertices[i-1], vertices[i], line);
+		cells.insert(cells.end(), line.begin() + 1, line.end());
+	}
+}
+
+void shortcut_path(const std::vector<std::vector<char> >& grid, const std::vector<Cell>& path, std::vector<Cell>& vertices, int max_cost)
+{
+	std::vector<Cell> cells;
+	std::vector<double> prefix;
+
+	vertices.clear();
+	for(int i = 0; i < path.size(); i++){
+		if(!cells.empty() && cells.back().x == path[i].x && cells.back().y == path[i].y)
+			continue;
+		cells.push_back(path[i]);
+	}
+	if(cells.empty())
+		return;
+
+	//元の経路に沿ったコストの累積和
+	prefix.push_back(0.0);
+	for(int i = 1; i < cells.size(); i++){
+		prefix.push_back(prefix.back() + line_cost(grid, cells[i-1], cells[i], 100));
+	}
+
+	int n = cells.size();
+	int i = 0;
+	vertices.push_back(cells[0]);
+	while(i < n - 1){
+		int j = i + 1;
+		for(int k = i + 2; k < n; k++){
+			double c = line_cost(grid, cells[i], cells[k], max_cost);
+			if(c == INF || c > prefix[k] - prefix[i] + 1e-6)
+				break;
+			j = k;
+		}
+		vertices.push_back(cells[j]);
+		i = j;
+	}
+}
+
+void shortcut_segments(const std::vector<std::vector<char> >& grid, const std::vector<std::vector<Cell> >& segments, std::vector<Cell>& vertices, int max_cost)
+{
+	std::vector<Cell> part;
+
+	vertices.clear();
+	for(int i = 0; i < segments.size(); i++){
+		shortcut_path(grid, segments[i], part, max_cost);
+		if(part.empty())
+			continue;
+		//前の区間の終点と同じなら重ねない
+		int first = (!vertices.empty() && vertices.back().x == part[0].x && vertices.back().y == part[0].y) ? 1 : 0;
+		vertices.insert(vertices.end(), part.begin() + first, part.end());
+	}
+}
+
+bool Theta_star::EntryCompare::operator()(const Entry& a, const Entry& b) const
+{
+	return a.f > b.f;
+}
+
+Theta_star::Theta_star(void)
+{
+	los_max_cost = 100;
+	expansions = 0;
+}
+
+void Theta_star::set_los_max_cost(int max_cost)
+{
+	los_max_cost = max_cost;
+}
+
+bool Theta_star::search(const std::vector<std::vector<char> >& grid, Cell start, Cell goal, std::vector<Cell>& vertices)
+{
+	int row = grid.size();
+	int col = row ? grid[0].size() : 0;
+	std::priority_queue<Entry, std::vector<Entry>, EntryCompare> open;
+
+	vertices.clear();
+	nodes.clear();
+	expansions = 0;
+	if(start.x < 0 || start.x >= row || start.y < 0 || start.y >= col
+			|| goal.x < 0 || goal.x >= row || goal.y < 0 || goal.y >= col)
+		return false;
+
+	int s_id = start.x*col + start.y;
+	int g_id = goal.x*col + goal.y;
+	Node s_node = {0.0, s_id, false};
+	nodes[s_id] = s_node;
+	Entry s_entry = {std::hypot(goal.x - start.x, goal.y - start.y), s_id, 0.0};
+	open.push(s_entry);
+
+	bool found = false;
+	while(!open.empty()){
+		Entry top = open.top();
+		open.pop();
+		Node& u = nodes[top.id];
+		if(u.closed || top.g != u.g)
+			continue;
+		u.closed = true;
+		expansions++;
+		if(top.id == g_id){
+			found = true;
+			break;
+		}
+
+		Cell c = {top.id / col, top.id % col};
+		Cell p = {u.parent / col, u.parent % col};
+		double g_p = nodes[u.parent].g;
+		for(int i = 0; i < 8; i++){
+			Cell c2 = {c.x + GRID_DELTA[i][0], c.y + GRID_DELTA[i][1]};
+			if(c2.x < 0 || c2.x >= row || c2.y < 0 || c2.y >= col || !is_passable(grid[c2.x][c2.y]))
+				continue;
+
+			int id2 = c2.x*col + c2.y;
+			std::unordered_map<int, Node>::iterator it = nodes.find(id2);
+			if(it != nodes.end() && it->second.closed)
+				continue;
+
+			//path 1: 隣接セルへの移動
+			double g2 = top.g + line_cost(grid, c, c2, 100);
+			int parent2 = top.id;
+			//path 2: 親から直接
+			if(u.parent != top.id){
+				double g_los = g_p + line_cost(grid, p, c2, los_max_cost);
+				if(g_los <= g2 + 1e-9){
+					g2 = g_los;
+					parent2 = u.parent;
+				}
+			}
+			if(g2 == INF)
+				continue;
+
+			if(it == nodes.end()){
+				Node n = {INF, id2, false};
+				it = nodes.insert(std::make_pair(id2, n)).first;
+			}
+			if(g2 < it->second.g){
+				it->second.g = g2;
+				it->second.parent = parent2;
+				Entry e = {g2 + std::hypot(goal.x - c2.x, goal.y - c2.y), id2, g2};
+				open.push(e);
+			}
+		}
+	}
+	if(!found)
+		return false;
+
+	int id = g_id;
+	while(true){
+		Cell v = {id / col, id % col};
+		vertices.push_back(v);
+		if(id == s_id)
+			break;
+		id = nodes[id].parent;
+	}
+	std::reverse(vertices.begin(), vertices.end());
+
+	return true;
+}
+
+int Theta_star::get_expansions(void) const
+{
+	return expansions;
+}